@@ -0,0 +1,85 @@
+#include "arena.h"
+#include "shared.h"
+#include <stdalign.h>
+#include <string.h>
+
+// Chunks start small, as most declarations are, and double in size up to the maximum.
+#define ARENA_INITIAL_CHUNK_SIZE 1024
+#define ARENA_MAXIMUM_CHUNK_SIZE (256 * 1024)
+
+typedef struct arena_chunk {
+	struct arena_chunk *previous;
+	size_t size;
+	alignas(max_align_t) char bytes[];
+} arena_chunk;
+
+// The arena itself lives at the start of its first chunk.
+struct arena {
+	arena_chunk *chunk;
+	size_t used;
+};
+
+static size_t align_size(size_t size) {
+	return (size + alignof(max_align_t) - 1) & ~(alignof(max_align_t) - 1);
+}
+
+static arena_chunk *new_chunk(arena_chunk *previous, size_t size) {
+	arena_chunk *chunk = xmalloc(sizeof(arena_chunk) + size);
+	chunk->previous = previous;
+	chunk->size = size;
+	return chunk;
+}
+
+arena *new_arena(void) {
+	arena_chunk *chunk = new_chunk(NULL, ARENA_INITIAL_CHUNK_SIZE);
+	arena *arena = (struct arena *) chunk->bytes;
+
+	arena->chunk = chunk;
+	arena->used = align_size(sizeof(struct arena));
+	return arena;
+}
+
+void free_arena(arena *arena) {
+	arena_chunk *chunk = arena->chunk;
+
+	// The first chunk (which holds `arena`) is the last one freed.
+	while (chunk != NULL) {
+		arena_chunk *previous = chunk->previous;
+		free(chunk);
+		chunk = previous;
+	}
+}
+
+void *arena_allocate(arena *arena, size_t size) {
+	size = align_size(size);
+
+	if (size > arena->chunk->size - arena->used) {
+		size_t chunk_size = arena->chunk->size * 2;
+		if (chunk_size > ARENA_MAXIMUM_CHUNK_SIZE)
+			chunk_size = ARENA_MAXIMUM_CHUNK_SIZE;
+		if (chunk_size < size)
+			chunk_size = size;
+
+		arena->chunk = new_chunk(arena->chunk, chunk_size);
+		arena->used = 0;
+	}
+
+	void *ptr = &arena->chunk->bytes[arena->used];
+	arena->used += size;
+	return ptr;
+}
+
+void *arena_reallocate(arena *arena, void *ptr, size_t old_size, size_t new_size) {
+	old_size = align_size(old_size);
+	new_size = align_size(new_size);
+
+	char *end = &arena->chunk->bytes[arena->used];
+	if ((char *) ptr + old_size == end && new_size - old_size <= arena->chunk->size - arena->used) {
+		arena->used += new_size - old_size;
+		return ptr;
+	}
+
+	void *new_ptr = arena_allocate(arena, new_size);
+	memcpy(new_ptr, ptr, old_size);
+	return new_ptr;
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <stddef.h>
+
+/*
+ * A bump allocator for data that's all freed together, such as the AST of a declaration. Nothing
+ * within an arena can be freed on its own; `free_arena` releases everything in one step.
+ */
+typedef struct arena arena;
+
+arena *new_arena(void);
+void free_arena(arena *arena);
+
+// Returns `size` bytes, suitably aligned for any type.
+void *arena_allocate(arena *arena, size_t size);
+
+// Grows `ptr`, which was allocated with `old_size` bytes, to `new_size` bytes. This is done in place if
+// it's the arena's most recent allocation; otherwise it's copied, and the old bytes go unused.
+void *arena_reallocate(arena *arena, void *ptr, size_t old_size, size_t new_size);
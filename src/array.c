@@ -155,6 +155,23 @@ array *concat_arrays(const array *lhs, const array *rhs) {
 	return ret;
 }
 
+void append_array(array *ary, const array *rhs) {
+	assert(ary->refcount == 1);
+
+	if (ary->capacity < ary->length + rhs->length) {
+		ary->capacity *= 2;
+		if (ary->capacity < ary->length + rhs->length)
+			ary->capacity = ary->length + rhs->length;
+
+		ary->elements = xrealloc(ary->elements, ary->capacity * sizeof(value));
+	}
+
+	for (unsigned i = 0; i < rhs->length; i++) {
+		ary->elements[ary->length] = clone_value(rhs->elements[i]);
+		ary->length++;
+	}
+}
+
 int compare_arrays(const array *lhs, const array *rhs) {
 	unsigned min_length = lhs->length < rhs->length ? lhs->length : rhs->length;
 
@@ -200,41 +217,36 @@ array *replicate_array(array *ary, unsigned amnt) {
 	return ret;
 }
 
-string *array_to_string(const array *ary) {
-	if (ary->length == 0)
-		return new_string(strdup("[]"), 2);
-
-	unsigned length = 1; // as we start with `[`.
-	unsigned capacity = 8;
-	char *str = xmalloc(capacity);
-	str[0] = '[';
+value array_to_string(const array *ary) {
+	string_builder builder;
+	init_string_builder(&builder, 8);
+	append_bytes_to_string_builder(&builder, "[", 1);
 
 	for (unsigned i = 0; i < ary->length; i++) {
-		string *inspected_string = inspect_value(ary->elements[i]);
-
-		// the `+ 2` is for the `, ` we add.
-		if (capacity <= length + inspected_string->length + 2) {
-			capacity = (length + inspected_string->length + 2) * 2;
-			str = xrealloc(str, capacity);
-		}
-
 		// If it's not the first element in the array, add `, ` before it.
-		if (i != 0) {
-			str[length] = ',';
-			str[length + 1] = ' ';
-			length += 2;
-		}
+		if (i != 0)
+			append_bytes_to_string_builder(&builder, ", ", 2);
 
-		memcpy(str + length, inspected_string->ptr, inspected_string->length);
-		length += inspected_string->length;
-		free_string(inspected_string);
+		value inspected = inspect_value(ary->elements[i]);
+		append_value_to_string_builder(&builder, inspected);
+		free_value(inspected);
 	}
 
-	// Allocate space for the trailing `]`
-	str = xrealloc(str, length + 1);
-	str[length] = ']';
+	append_bytes_to_string_builder(&builder, "]", 1);
+	return finish_string_builder(&builder);
+}
+
+void print_array(FILE *out, const array *ary) {
+	putc('[', out);
+
+	for (unsigned i = 0; i < ary->length; i++) {
+		if (i != 0)
+			fputs(", ", out);
+
+		print_inspected_value(out, ary->elements[i]);
+	}
 
-	return new_string(str, length + 1);
+	putc(']', out);
 }
 
 void dump_array(FILE *out, const array *ary) {
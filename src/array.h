@@ -116,6 +116,10 @@ bool insert_at_array(array *ary, int index, value val);
  */
 array *concat_arrays(const array *lhs, const array *rhs);
 
+/** Appends clones of `rhs`'s elements onto `ary`, which nothing else may refer to.
+ */
+void append_array(array *ary, const array *rhs);
+
 /** Compares `lhs` to `rhs`, returning a negative, zero, or positive number if `lhs` is less than,
  * equal to, or greater than `rhs`.
  * 
@@ -127,5 +131,8 @@ int compare_arrays(const array *lhs, const array *rhs);
 bool equate_arrays(const array *lhs, const array *rhs);
 array *replicate_array(array *ary, unsigned amnt);
 
-string *array_to_string(const array *ary);
+value array_to_string(const array *ary);
+
+// Writes what `array_to_string` would return to `out`, without building it up first.
+void print_array(FILE *out, const array *ary);
 void dump_array(FILE *out, const array *ary);
@@ -9,7 +9,7 @@
 	fprintf(stderr, __VA_ARGS__), \
 	fputs(" (offending token: ", stderr), \
 	dump_token(stderr, peek(tzr)), \
-	fputs(" )", stderr), \
+	fputs(" )\n", stderr), \
 	exit(1))
 
 static token peek(tokenizer *tzr) {
@@ -39,7 +39,7 @@ static bool guard(tokenizer *tzr, token_kind kind) {
 	return false;
 }
 
-static char *expect_identifier(tokenizer *tzr, const char *whence) {
+static symbol expect_identifier(tokenizer *tzr, const char *whence) {
 	token tkn = advance(tzr);
 
 	if (tkn.kind != TOKEN_KIND_IDENTIFIER)
@@ -50,7 +50,7 @@ static char *expect_identifier(tokenizer *tzr, const char *whence) {
 
 static ast_expression *parse_expression(tokenizer *tzr);
 static ast_primary *parse_primary(tokenizer *tzr) {
-	ast_primary *primary = xmalloc(sizeof(ast_primary));
+	ast_primary *primary = arena_allocate(tzr->ast_arena, sizeof(ast_primary));
 	token tkn = advance(tzr);
 
 	// Parse the initial primary
@@ -72,13 +72,17 @@ static ast_primary *parse_primary(tokenizer *tzr) {
 
 		unsigned capacity = 4;
 		primary->array_literal.length = 0;
-		primary->array_literal.elements = xmalloc(capacity * sizeof(ast_expression *));
+		primary->array_literal.elements = arena_allocate(tzr->ast_arena, capacity * sizeof(ast_expression *));
 
 		while (!guard(tzr, TOKEN_KIND_RBRACKET)) {
 			if (primary->array_literal.length == capacity) {
+				primary->array_literal.elements = arena_reallocate(
+					tzr->ast_arena,
+					primary->array_literal.elements,
+					capacity * sizeof(ast_expression *),
+					capacity * 2 * sizeof(ast_expression *)
+				);
 				capacity *= 2;
-				primary->array_literal.elements =
-					xrealloc(primary->array_literal.elements, capacity * sizeof(ast_expression *));
 			}
 
 			primary->array_literal.elements[primary->array_literal.length] = parse_expression(tzr);
@@ -117,7 +121,6 @@ static ast_primary *parse_primary(tokenizer *tzr) {
 
 	default:
 		unadvance(tzr, tkn);
-		free(primary);
 		return NULL;
 	}
 
@@ -129,7 +132,7 @@ static ast_primary *parse_primary(tokenizer *tzr) {
 
 		switch (tkn.kind) {
 		case TOKEN_KIND_LBRACKET:
-			temp_primary = xmalloc(sizeof(ast_primary));
+			temp_primary = arena_allocate(tzr->ast_arena, sizeof(ast_primary));
 			temp_primary->kind = AST_PRIMARY_INDEX;
 			temp_primary->index.source = primary;
 			primary = temp_primary;
@@ -145,20 +148,24 @@ static ast_primary *parse_primary(tokenizer *tzr) {
 			break;
 
 		case TOKEN_KIND_LPAREN:
-			temp_primary = xmalloc(sizeof(ast_primary));
+			temp_primary = arena_allocate(tzr->ast_arena, sizeof(ast_primary));
 			temp_primary->kind = AST_PRIMARY_FUNCTION_CALL;
 			temp_primary->function_call.function = primary;
 			primary = temp_primary;
 
 			unsigned capacity = 4;
 			primary->function_call.number_of_arguments = 0;
-			primary->function_call.arguments = xmalloc(capacity * sizeof(ast_expression *));
+			primary->function_call.arguments = arena_allocate(tzr->ast_arena, capacity * sizeof(ast_expression *));
 
 			while (!guard(tzr, TOKEN_KIND_RPAREN)) {
 				if (primary->function_call.number_of_arguments == capacity) {
+					primary->function_call.arguments = arena_reallocate(
+						tzr->ast_arena,
+						primary->function_call.arguments,
+						capacity * sizeof(ast_expression *),
+						capacity * 2 * sizeof(ast_expression *)
+					);
 					capacity *= 2;
-					primary->function_call.arguments =
-						xrealloc(primary->function_call.arguments, capacity * sizeof(ast_expression *));
 				}
 
 				primary->function_call.arguments[primary->function_call.number_of_arguments] =
@@ -210,7 +217,7 @@ static ast_expression *parse_expression(tokenizer *tzr) {
 	if (primary == NULL)
 		return NULL;
 
-	ast_expression *expression = xmalloc(sizeof(ast_expression));
+	ast_expression *expression = arena_allocate(tzr->ast_arena, sizeof(ast_expression));
 	token tkn = advance(tzr);
 
 	switch (tkn.kind) {
@@ -244,7 +251,6 @@ static ast_expression *parse_expression(tokenizer *tzr) {
 			parse_error(tzr, "you may online assign to identifiers and array indexes");
 		}
 
-		free(primary);
 		break;
 	}
 
@@ -296,7 +302,7 @@ static ast_expression *parse_expression(tokenizer *tzr) {
 static ast_block *parse_block(tokenizer *tzr);
 
 static ast_statement *parse_statement(tokenizer *tzr) {
-	ast_statement *statement = xmalloc(sizeof(ast_statement));
+	ast_statement *statement = arena_allocate(tzr->ast_arena, sizeof(ast_statement));
 	token tkn = advance(tzr);
 
 	switch (tkn.kind) {
@@ -396,10 +402,8 @@ static ast_statement *parse_statement(tokenizer *tzr) {
 		unadvance(tzr, tkn);
 		statement->kind = AST_STATEMENT_EXPRESSION;
 		statement->expression = parse_expression(tzr);
-		if (statement->expression == NULL) {
-			free(statement);
+		if (statement->expression == NULL)
 			return NULL;
-		}
 
 		// if (!guard(tzr, TOKEN_KIND_SEMICOLON))
 		// 	parse_error(tzr, "expected `;` after expression");
@@ -414,11 +418,11 @@ static ast_block *parse_block(tokenizer *tzr) {
 	// if (!guard(tzr, TOKEN_KIND_LBRACE))
 	// 	return NULL;
 
-	ast_block *block = xmalloc(sizeof(ast_block));
+	ast_block *block = arena_allocate(tzr->ast_arena, sizeof(ast_block));
 
 	unsigned capacity = 4;
 	block->number_of_statements = 0;
-	block->statements = xmalloc(capacity * sizeof(ast_statement *));
+	block->statements = arena_allocate(tzr->ast_arena, capacity * sizeof(ast_statement *));
 
 	while (!guard(tzr, TOKEN_KIND_RBRACE)) {
 		while (guard(tzr, TOKEN_KIND_SEMICOLON)) {
@@ -433,8 +437,13 @@ static ast_block *parse_block(tokenizer *tzr) {
 		}
 
 		if (capacity == block->number_of_statements) {
+			block->statements = arena_reallocate(
+				tzr->ast_arena,
+				block->statements,
+				capacity * sizeof(ast_statement *),
+				capacity * 2 * sizeof(ast_statement *)
+			);
 			capacity *= 2;
-			block->statements = xrealloc(block->statements, capacity * sizeof(ast_statement *));
 		}
 
 		block->statements[block->number_of_statements] = statement;
@@ -445,7 +454,11 @@ static ast_block *parse_block(tokenizer *tzr) {
 }
 
 ast_declaration *next_declaration(tokenizer *tzr) {
-	ast_declaration *declaration = xmalloc(sizeof(ast_declaration));
+	// Each declaration gets its own arena, as functions' bodies are kept around until they're compiled.
+	tzr->ast_arena = new_arena();
+
+	ast_declaration *declaration = arena_allocate(tzr->ast_arena, sizeof(ast_declaration));
+	declaration->arena = tzr->ast_arena;
 	token tkn = advance(tzr);
 
 	declaration->source.line_number = tzr->line_number;
@@ -470,11 +483,10 @@ ast_declaration *next_declaration(tokenizer *tzr) {
 		// 	parse_error(tzr, "expected `;` after `import` declaration");
 
 
-		// `read_file` expects a nul terminated string, but `string`s are not nul terminated.
+		// `compile_file` expects a nul terminated string, but `string`s are not nul terminated.
 		// So we have to make one.
-		string *path_string = as_string(path_token.val);
-		declaration->import.path = new_cstr_from_string(path_string);
-		free_string(path_string);
+		declaration->import.path = new_cstr_from_string(path_token.val);
+		free_value(path_token.val);
 
 		if (declaration->import.path == NULL)
 			parse_error(tzr, "friend paths must not contain `\\0`");
@@ -490,13 +502,13 @@ ast_declaration *next_declaration(tokenizer *tzr) {
 
 		unsigned capacity = 4;
 		declaration->function.number_of_arguments = 0;
-		declaration->function.argument_names = xmalloc(capacity * sizeof(char *));
+		declaration->function.argument_names = xmalloc(capacity * sizeof(symbol));
 
 		while (!guard(tzr, TOKEN_KIND_RPAREN)) {
 			if (declaration->function.number_of_arguments == capacity) {
 				capacity *= 2;
 				declaration->function.argument_names =
-					xrealloc(declaration->function.argument_names, capacity * sizeof(char *));
+					xrealloc(declaration->function.argument_names, capacity * sizeof(symbol));
 			}
 
 			declaration->function.argument_names[declaration->function.number_of_arguments] =
@@ -512,12 +524,13 @@ ast_declaration *next_declaration(tokenizer *tzr) {
 
 		declaration->function.body = parse_block(tzr);
 		if (declaration->function.body == NULL)
-			parse_error(tzr, "expected body for zone %s", declaration->function.name);
+			parse_error(tzr, "expected body for zone %s", symbol_name(declaration->function.name));
 
 		break;
 
 	case TOKEN_KIND_UNDEFINED:
-		free(declaration);
+		free_arena(tzr->ast_arena);
+		tzr->ast_arena = NULL;
 		return NULL;
 
 	default:
@@ -529,6 +542,120 @@ ast_declaration *next_declaration(tokenizer *tzr) {
 	return declaration;
 }
 
+/*
+ * The AST's nodes all live in their declaration's arena, so the only thing that needs freeing on its
+ * own is the literals' values, which the compiler takes ownership of instead when it compiles them.
+ */
+static void free_literals_in_expression(ast_expression *expression);
+static void free_literals_in_primary(ast_primary *primary) {
+	switch (primary->kind) {
+	case AST_PRIMARY_PAREN:
+		free_literals_in_expression(primary->paren.expression);
+		break;
+
+	case AST_PRIMARY_INDEX:
+		free_literals_in_primary(primary->index.source);
+		free_literals_in_expression(primary->index.index);
+		break;
+
+	case AST_PRIMARY_FUNCTION_CALL:
+		free_literals_in_primary(primary->function_call.function);
+		for (unsigned i = 0; i < primary->function_call.number_of_arguments; i++)
+			free_literals_in_expression(primary->function_call.arguments[i]);
+		break;
+
+	case AST_PRIMARY_UNARY_OPERATOR:
+		free_literals_in_primary(primary->unary_operator.primary);
+		break;
+
+	case AST_PRIMARY_ARRAY_LITERAL:
+		for (unsigned i = 0; i < primary->array_literal.length; i++)
+			free_literals_in_expression(primary->array_literal.elements[i]);
+		break;
+
+	case AST_PRIMARY_VARIABLE:
+		break;
+
+	case AST_PRIMARY_LITERAL:
+		free_value(primary->literal.val);
+		break;
+	}
+}
+
+static void free_literals_in_expression(ast_expression *expression) {
+	switch (expression->kind) {
+	case AST_EXPRESSION_ASSIGN:
+		free_literals_in_expression(expression->assign.value);
+		break;
+
+	case AST_EXPRESSION_INDEX_ASSIGN:
+		free_literals_in_primary(expression->index_assign.source);
+		free_literals_in_expression(expression->index_assign.index);
+		free_literals_in_expression(expression->index_assign.value);
+		break;
+
+	case AST_EXPRESSION_SHORT_CIRCUIT_OPERATOR:
+		free_literals_in_primary(expression->short_circuit_operator.lhs);
+		free_literals_in_expression(expression->short_circuit_operator.rhs);
+		break;
+
+	case AST_EXPRESSION_BINARY_OPERATOR:
+		free_literals_in_primary(expression->binary_operator.lhs);
+		free_literals_in_expression(expression->binary_operator.rhs);
+		break;
+
+	case AST_EXPRESSION_PRIMARY:
+		free_literals_in_primary(expression->primary);
+		break;
+	}
+}
+
+static void free_literals_in_statement(ast_statement *statement) {
+	switch (statement->kind) {
+	case AST_STATEMENT_LOCAL:
+		if (statement->local.initializer != NULL)
+			free_literals_in_expression(statement->local.initializer);
+		break;
+
+	case AST_STATEMENT_RETURN:
+		if (statement->return_.expression != NULL)
+			free_literals_in_expression(statement->return_.expression);
+		break;
+
+	case AST_STATEMENT_IF:
+		free_literals_in_expression(statement->if_.condition);
+		free_ast_literals(statement->if_.if_true);
+		if (statement->if_.if_false != NULL)
+			free_ast_literals(statement->if_.if_false);
+		break;
+
+	case AST_STATEMENT_WHILE:
+		free_literals_in_expression(statement->while_.condition);
+		free_ast_literals(statement->while_.body);
+		break;
+
+	case AST_STATEMENT_FOR:
+		free_literals_in_statement(statement->for_.initializer);
+		free_literals_in_expression(statement->for_.condition);
+		free_literals_in_expression(statement->for_.updator);
+		free_ast_literals(statement->for_.body);
+		break;
+
+	case AST_STATEMENT_BREAK:
+	case AST_STATEMENT_CONTINUE:
+		break;
+
+	case AST_STATEMENT_EXPRESSION:
+		free_literals_in_expression(statement->expression);
+		break;
+	}
+}
+
+void free_ast_literals(ast_block *block) {
+	for (unsigned i = 0; i < block->number_of_statements; i++)
+		free_literals_in_statement(block->statements[i]);
+}
+
 void dump_ast_primary(FILE *out, const ast_primary *primary) {
 	switch (primary->kind) {
 	case AST_PRIMARY_PAREN:
@@ -576,7 +703,7 @@ void dump_ast_primary(FILE *out, const ast_primary *primary) {
 		break;
 
 	case AST_PRIMARY_VARIABLE:
-		fputs(primary->variable.name, out);
+		fputs(symbol_name(primary->variable.name), out);
 		break;
 
 	case AST_PRIMARY_LITERAL:
@@ -605,7 +732,7 @@ static const char *binary_operator_to_string(binary_operator op) {
 void dump_ast_expression(FILE *out, const ast_expression *expression) {
 	switch (expression->kind) {
 	case AST_EXPRESSION_ASSIGN:
-		fputs(expression->assign.name, out);
+		fputs(symbol_name(expression->assign.name), out);
 		fprintf(out, " %s ", binary_operator_to_string(expression->assign.operator));
 		dump_ast_expression(out, expression->assign.value);
 		break;
@@ -643,7 +770,7 @@ void dump_ast_expression(FILE *out, const ast_expression *expression) {
 void dump_ast_statement(FILE *out, const ast_statement *statement, unsigned indent) {
 	switch (statement->kind) {
 	case AST_STATEMENT_LOCAL:
-		fprintf(out, "local %s", statement->local.name);
+		fprintf(out, "local %s", symbol_name(statement->local.name));
 		if (statement->local.initializer != NULL) {
 			fputs(" = ", out);
 			dump_ast_expression(out, statement->local.initializer);
@@ -720,20 +847,20 @@ void dump_ast_block(FILE *out, const ast_block *block, unsigned indent) {
 void dump_ast_declaration(FILE *out, const ast_declaration *declaration) {
 	switch (declaration->kind) {
 	case AST_DECLARATION_GLOBAL:
-		fprintf(out, "global %s;\n", declaration->global.name);
+		fprintf(out, "global %s;\n", symbol_name(declaration->global.name));
 		break;
 	case AST_DECLARATION_IMPORT:
 		// this won't escape special characters, but eh, it's debug code, so whatever.
 		fprintf(out, "import \"%s\";\n", declaration->import.path);
 		break;
 	case AST_DECLARATION_FUNCTION:
-		fprintf(out, "function %s(", declaration->function.name);
+		fprintf(out, "function %s(", symbol_name(declaration->function.name));
 
 		for (unsigned i = 0; i < declaration->function.number_of_arguments; i++) {
 			if (i != 0)
 				fputs(", ", out);
 
-			fputs(declaration->function.argument_names[i], out);
+			fputs(symbol_name(declaration->function.argument_names[i]), out);
 		}
 
 		fputs(") ", out);
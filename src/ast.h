@@ -53,7 +53,7 @@ struct ast_primary {
 		} array_literal;
 
 		struct {
-			char *name;
+			symbol name;
 		} variable;
 
 		struct {
@@ -94,7 +94,7 @@ struct ast_expression {
 	union {
 		struct {
 			binary_operator operator; // Set to `BINARY_OP_UNDEF` when normal assignment.
-			char *name;
+			symbol name;
 			ast_expression *value;
 		} assign;
 
@@ -134,7 +134,7 @@ struct ast_statement {
 
 	union {
 		struct {
-			char *name;
+			symbol name;
 			ast_expression *initializer; // is `NULL` if no default is given.
 		} local;
 
@@ -180,20 +180,24 @@ struct ast_declaration {
 		unsigned line_number;
 	} source;
 
+	// Holds the declaration and all of its nodes. Only `import.path` and `function.argument_names`
+	// are allocated separately, as they outlive the AST.
+	arena *arena;
+
 	union {
 		struct {
 			char *path;
 		} import;
 
 		struct {
-			char *name;
+			symbol name;
 		} global;
 
 		struct {
-			char *name;
+			symbol name;
 
 			unsigned number_of_arguments;
-			char **argument_names;
+			symbol *argument_names;
 
 			ast_block *body;
 		} function;
@@ -202,11 +206,9 @@ struct ast_declaration {
 
 ast_declaration *next_declaration(tokenizer *tzr);
 
-void free_ast_primary(ast_primary *primary);
-void free_ast_expression(ast_expression *expression);
-void free_ast_statement(ast_statement *statement);
-void free_ast_block(ast_block *block);
-void free_ast_declaration(ast_declaration *declaration);
+// Frees the values of the literals within `block`, for when it's discarded without being compiled.
+// The nodes themselves are freed along with their declaration's arena.
+void free_ast_literals(ast_block *block);
 
 void dump_ast_primary(FILE *out, const ast_primary *primary);
 void dump_ast_expression(FILE *out, const ast_expression *expression);
@@ -1,9 +1,33 @@
 #include "builtin_function.h"
 #include "value.h"
+#include <limits.h>
+#include <string.h>
 #include <time.h>
 #include <unistd.h>
 
+#define STDOUT_BUFFER_SIZE 65536
+
+// Printing doesn't flush stdout itself, so this is the only thing deciding how often it's written.
+static void init_stdout_buffering(void) {
+	static char buffer[STDOUT_BUFFER_SIZE];
+	const char *policy = getenv("EMERALD_STDOUT_BUFFERING");
+	int mode;
+
+	if (policy == NULL)
+		mode = isatty(STDOUT_FILENO) ? _IOLBF : _IOFBF;
+	else if (strcmp(policy, "line") == 0)
+		mode = _IOLBF;
+	else if (strcmp(policy, "block") == 0)
+		mode = _IOFBF;
+	else
+		die("unknown stdout buffering '%s', expected 'line' or 'block'", policy);
+
+	setvbuf(stdout, buffer, mode, sizeof(buffer));
+}
+
 void init_builtin_functions(void) {
+	init_stdout_buffering();
+
 	// the `srandom` function provides much better random numbers, but isn't technically standard.
 #ifdef SRANDOM_UNDEFINED
 	srand(time(NULL));
@@ -33,12 +57,15 @@ static value builtin_to_num_fn(const value *arguments) {
 	if (!is_string(arguments[0]))
 		die_with_stacktrace("Can only convert strings to numbers, not %s", value_name(arguments[0]));
 
-	return new_number_value(string_to_number(as_string(arguments[0])));
+	return new_number_value(string_to_number(arguments[0]));
 }
 
 static value builtin_prompt_fn(const value *arguments) {
 	(void) arguments;
 
+	// Make sure whatever's asking for the line has been shown.
+	fflush(stdout);
+
 	size_t capacity = 0;
 	ssize_t length;
 	char *line = NULL;
@@ -51,7 +78,7 @@ static value builtin_prompt_fn(const value *arguments) {
 		if (!feof(stdin))
 			die_with_stacktrace("unable to read line from stdin");
 
-		return new_string_value(new_string(strdup(""), 0));
+		return new_string_value_from_bytes("", 0);
 	}
 
 	assert(0 < length);
@@ -64,19 +91,15 @@ static value builtin_prompt_fn(const value *arguments) {
 			length--;
 	}
 
-	value ret = new_string_value(new_string(strndup(line, length), length));
+	value ret = new_string_value_from_bytes(line, length);
 	free(line);
 
 	return ret;
 }
 
 static value builtin_print_fn(const value *arguments) {
-	string *to_print = value_to_string(arguments[0]);
+	print_value(stdout, arguments[0]);
 
-	printf("%.*s", to_print->length, to_print->ptr);
-	fflush(stdout);
-
-	free_string(to_print);
 	return VALUE_NULL;
 }
 
@@ -101,23 +124,32 @@ static value builtin_random_fn(const value *arguments) {
 	return new_number_value(ret);
 }
 
-static value builtin_length_fn(const value *arguments) {
-	switch (classify(arguments[0])) {
+value builtin_length(value val) {
+	switch (classify(val)) {
 	case VALUE_KIND_ARRAY:
-		return new_number_value(as_array(arguments[0])->length);
+		return new_number_value(as_array(val)->length);
 
 	case VALUE_KIND_STRING:
-		return new_number_value(as_string(arguments[0])->length);
+		return new_number_value(string_length(val));
+
+	case VALUE_KIND_STRING_BUILDER:
+		return new_number_value(as_string_builder(val)->length);
 
 	default:
-		die_with_stacktrace("can only get the length of arrays and strings, not %s", value_name(arguments[0]));
+		die_with_stacktrace("can only get the length of arrays, strings, and ringboxes, not %s", value_name(val));
 	}
 }
 
+static value builtin_length_fn(const value *arguments) {
+	return builtin_length(arguments[0]);
+}
+
 static value builtin_exit_fn(const value *arguments) {
 	if (!is_number(arguments[0]))
 		die_with_stacktrace("can only exit with an integer status code, not %s", value_name(arguments[0]));
 
+	// `exit` flushes stdout too, but only after leak checkers have had their chance to exit first.
+	fflush(stdout);
 	exit(as_number(arguments[0]));
 }
 
@@ -153,79 +185,182 @@ static value builtin_insert_fn(const value *arguments) {
 	return clone_value(arguments[0]);
 }
 
-static value builtin_typeof_fn(const value *arguments) {
-	const char *typename = value_name(arguments[0]);
+value builtin_typeof(value val) {
+	const char *typename = value_name(val);
 
-	return new_string_value(new_string(strdup(typename), strlen(typename)));
+	return intern_string_value(typename, strlen(typename));
+}
+
+static value builtin_typeof_fn(const value *arguments) {
+	return builtin_typeof(arguments[0]);
 }
 
 static value builtin_sleep_fn(const value *arguments) {
 	if (!is_number(arguments[0]))
 		die_with_stacktrace("can only sleep for number seconds");
 
+	// Otherwise, what was printed before sleeping wouldn't be seen until afterwards.
+	fflush(stdout);
 	return new_number_value(sleep(as_number(arguments[0])));
 }
 
+static value builtin_string_builder_fn(const value *arguments) {
+	(void) arguments;
+
+	return new_string_builder_value(new_string_builder(16));
+}
+
+static string_builder *string_builder_argument(const char *name, value val) {
+	if (!is_string_builder(val))
+		die_with_stacktrace("can only %s ringboxes, not %s", name, value_name(val));
+
+	return as_string_builder(val);
+}
+
+static value builtin_append_fn(const value *arguments) {
+	append_value_to_string_builder(string_builder_argument("collect into", arguments[0]), arguments[1]);
+
+	return clone_value(arguments[0]);
+}
+
+static value builtin_append_all_fn(const value *arguments) {
+	string_builder *builder = string_builder_argument("collect into", arguments[0]);
+
+	if (!is_array(arguments[1]))
+		die_with_stacktrace("can only collect everything in arrays, not %s", value_name(arguments[1]));
+
+	const array *ary = as_array(arguments[1]);
+	for (unsigned i = 0; i < ary->length; i++)
+		append_value_to_string_builder(builder, ary->elements[i]);
+
+	return clone_value(arguments[0]);
+}
+
+static value builtin_reserve_fn(const value *arguments) {
+	string_builder *builder = string_builder_argument("reserve space in", arguments[0]);
+
+	if (!is_number(arguments[1]) || as_number(arguments[1]) < 0)
+		die_with_stacktrace("can only reserve a nonnegative number of bytes, not %s", value_name(arguments[1]));
+
+	reserve_string_builder(builder, as_number(arguments[1]));
+	return clone_value(arguments[0]);
+}
+
+static value builtin_finish_string_fn(const value *arguments) {
+	return finish_string_builder(string_builder_argument("clear", arguments[0]));
+}
+
+static value builtin_slice_fn(const value *arguments) {
+	if (!is_string(arguments[0]))
+		die_with_stacktrace("can only slice strings, not %s", value_name(arguments[0]));
+
+	if (!is_number(arguments[1]) || !is_number(arguments[2]))
+		die_with_stacktrace("can only slice with numbers, not %s and %s", value_name(arguments[1]), value_name(arguments[2]));
+
+	number start = as_number(arguments[1]), length = as_number(arguments[2]);
+	value slice = VALUE_UNDEFINED;
+
+	if (INT_MIN <= start && start <= INT_MAX && 0 <= length && length <= UINT_MAX)
+		slice = slice_string(arguments[0], start, length);
+
+	if (slice == VALUE_UNDEFINED) {
+		die_with_stacktrace("slice of length %lld at %lld out of bounds for string of length %u",
+			length, start, string_length(arguments[0]));
+	}
+
+	return slice;
+}
+
 builtin_function builtin_functions[] = {
-	{
+	[BUILTIN_TO_NUM] = {
 		.name = "to_ring",
 		.required_argument_count = 1,
 		.function_pointer = builtin_to_num_fn
 	},
-	{
+	[BUILTIN_PROMPT] = {
 		.name = "sotellme",
 		.required_argument_count = 0,
 		.function_pointer = builtin_prompt_fn
 	},
-	{
+	[BUILTIN_PRINT] = {
 		.name = "gottago",
 		.required_argument_count = 1,
 		.function_pointer = builtin_print_fn
 	},
-	{
+	[BUILTIN_PRINTLN] = {
 		.name = "gottagofast",
 		.required_argument_count = 1,
 		.function_pointer = builtin_println_fn
 	},
-	{
+	[BUILTIN_RANDOM] = {
 		.name = "chaos",
 		.required_argument_count = 0,
 		.function_pointer = builtin_random_fn
 	},
-	{
+	[BUILTIN_LENGTH] = {
 		.name = "shoe_size",
 		.required_argument_count = 1,
 		.function_pointer = builtin_length_fn
 	},
-	{
+	[BUILTIN_EXIT] = {
 		.name = "falloffthetrack",
 		.required_argument_count = 1,
 		.function_pointer = builtin_exit_fn
 	},
-	{
+	[BUILTIN_DUMP] = {
 		.name = "amy",
 		.required_argument_count = 1,
 		.function_pointer = builtin_dump_fn
 	},
-	{
+	[BUILTIN_DELETE] = {
 		.name = "buhbyenow",
 		.required_argument_count = 2,
 		.function_pointer = builtin_delete_fn
 	},
-	{
+	[BUILTIN_INSERT] = {
 		.name = "hereitgoes",
 		.required_argument_count = 3,
 		.function_pointer = builtin_insert_fn
 	},
-	{
+	[BUILTIN_TYPEOF] = {
 		.name = "species",
 		.required_argument_count = 1,
 		.function_pointer = builtin_typeof_fn
 	},
-	{
+	[BUILTIN_SLEEP] = {
 		.name = "imwaiting",
 		.required_argument_count = 1,
 		.function_pointer = builtin_sleep_fn
 	},
+	[BUILTIN_STRING_BUILDER] = {
+		.name = "ringbox",
+		.required_argument_count = 0,
+		.function_pointer = builtin_string_builder_fn
+	},
+	[BUILTIN_APPEND] = {
+		.name = "collect",
+		.required_argument_count = 2,
+		.function_pointer = builtin_append_fn
+	},
+	[BUILTIN_APPEND_ALL] = {
+		.name = "collectemall",
+		.required_argument_count = 2,
+		.function_pointer = builtin_append_all_fn
+	},
+	[BUILTIN_RESERVE] = {
+		.name = "superring",
+		.required_argument_count = 2,
+		.function_pointer = builtin_reserve_fn
+	},
+	[BUILTIN_FINISH_STRING] = {
+		.name = "actclear",
+		.required_argument_count = 1,
+		.function_pointer = builtin_finish_string_fn
+	},
+	[BUILTIN_SLICE] = {
+		.name = "spinslash",
+		.required_argument_count = 3,
+		.function_pointer = builtin_slice_fn
+	},
 };
 
@@ -9,9 +9,38 @@ typedef struct {
 	value (*function_pointer)(const value *arguments);
 } builtin_function;
 
-#define NUMBER_OF_BUILTIN_FUNCTIONS 12
+// The index of each builtin within `builtin_functions`. The compiler uses these to bind calls to
+// builtins directly, and to turn the most common ones into dedicated opcodes.
+typedef enum {
+	BUILTIN_TO_NUM,
+	BUILTIN_PROMPT,
+	BUILTIN_PRINT,
+	BUILTIN_PRINTLN,
+	BUILTIN_RANDOM,
+	BUILTIN_LENGTH,
+	BUILTIN_EXIT,
+	BUILTIN_DUMP,
+	BUILTIN_DELETE,
+	BUILTIN_INSERT,
+	BUILTIN_TYPEOF,
+	BUILTIN_SLEEP,
+	BUILTIN_STRING_BUILDER,
+	BUILTIN_APPEND,
+	BUILTIN_APPEND_ALL,
+	BUILTIN_RESERVE,
+	BUILTIN_FINISH_STRING,
+	BUILTIN_SLICE,
+	NUMBER_OF_BUILTIN_FUNCTIONS
+} builtin_function_index;
+
 extern builtin_function builtin_functions[NUMBER_OF_BUILTIN_FUNCTIONS];
 
+/*
+ * Also sets how stdout is buffered, which `EMERALD_STDOUT_BUFFERING` picks: `line` flushes after each
+ * line, and `block` only once the buffer's full. Either way, it's flushed before `sotellme` reads a
+ * line, before `imwaiting` sleeps and when exiting. If it's not set, it's `line` for terminals and `block`
+ * for everything else.
+ */
 void init_builtin_functions(void);
 
 value call_builtin_function(
@@ -20,4 +49,8 @@ value call_builtin_function(
 	const value *arguments
 );
 
+// The bodies of `shoe_size` and `species`, which are also used by their intrinsic opcodes.
+value builtin_length(value val);
+value builtin_typeof(value val);
+
 void dump_builtin_function(FILE *out, const builtin_function *builtin_func);
@@ -1,4 +1,5 @@
 #include "bytecode.h"
+#include "shared.h"
 
 const char *opcode_repr(opcode op) {
 	switch (op) {
@@ -13,11 +14,16 @@ const char *opcode_repr(opcode op) {
 	case OPCODE_JUMP_IF_TRUE:  return "JUMP_IF_TRUE";
 	case OPCODE_JUMP_IF_FALSE: return "JUMP_IF_FALSE";
 	case OPCODE_CALL:          return "CALL";
+	case OPCODE_CALL_BUILTIN:  return "CALL_BUILTIN";
 	case OPCODE_RETURN:        return "RETURN";
 
+	case OPCODE_LENGTH: return "LENGTH";
+	case OPCODE_TYPEOF: return "TYPEOF";
+
 	case OPCODE_NOT:      return "NOT";
 	case OPCODE_NEGATE:   return "NEGATE";
 	case OPCODE_ADD:      return "ADD";
+	case OPCODE_APPEND:   return "APPEND";
 	case OPCODE_SUBTRACT: return "SUBTRACT";
 	case OPCODE_MULTIPLY: return "MULTIPLY";
 	case OPCODE_DIVIDE:   return "DIVIDE";
@@ -32,5 +38,65 @@ const char *opcode_repr(opcode op) {
 
 	case OPCODE_INDEX:        return "INDEX";
 	case OPCODE_INDEX_ASSIGN: return "INDEX_ASSIGN";
+	case OPCODE_INDEX_ELEMENTS: return "INDEX_ELEMENTS";
 	}
 }
+
+unsigned instruction_length(const bytecode *code) {
+	switch (code[0].op) {
+	case OPCODE_RETURN:
+		return 1;
+
+	case OPCODE_JUMP:
+		return 2;
+
+	case OPCODE_MOVE:
+	case OPCODE_LOAD_CONSTANT:
+	case OPCODE_LOAD_GLOBAL_VARIABLE:
+	case OPCODE_JUMP_IF_TRUE:
+	case OPCODE_JUMP_IF_FALSE:
+	case OPCODE_NOT:
+	case OPCODE_NEGATE:
+		return 3;
+
+	case OPCODE_STORE_GLOBAL_VARIABLE:
+	case OPCODE_LENGTH:
+	case OPCODE_TYPEOF:
+	case OPCODE_ADD:
+	case OPCODE_APPEND:
+	case OPCODE_SUBTRACT:
+	case OPCODE_MULTIPLY:
+	case OPCODE_DIVIDE:
+	case OPCODE_MODULO:
+	case OPCODE_EQUAL:
+	case OPCODE_NOT_EQUAL:
+	case OPCODE_LESS_THAN:
+	case OPCODE_LESS_THAN_OR_EQUAL:
+	case OPCODE_GREATER_THAN:
+	case OPCODE_GREATER_THAN_OR_EQUAL:
+	case OPCODE_INDEX:
+		return 4;
+
+	case OPCODE_INDEX_ASSIGN:
+		return 5;
+
+	// opcode, count, `count` locals, target
+	case OPCODE_ARRAY_LITERAL:
+		return 3 + code[1].count;
+
+	// opcode, function, count, `count` arguments, target
+	case OPCODE_CALL:
+		return 4 + code[2].count;
+
+	// opcode, global, builtin, count, `count` arguments, target
+	case OPCODE_CALL_BUILTIN:
+		return 5 + code[3].count;
+
+	// opcode, count, `count` elements, index, target
+	case OPCODE_INDEX_ELEMENTS:
+		return 4 + code[1].count;
+	}
+
+	bug("unknown opcode %d", code[0].op);
+	return 0;
+}
@@ -12,11 +12,16 @@ typedef enum {
 	OPCODE_JUMP_IF_TRUE,
 	OPCODE_JUMP_IF_FALSE,
 	OPCODE_CALL,
+	OPCODE_CALL_BUILTIN,
 	OPCODE_RETURN,
 
+	OPCODE_LENGTH,
+	OPCODE_TYPEOF,
+
 	OPCODE_NOT,
 	OPCODE_NEGATE,
 	OPCODE_ADD,
+	OPCODE_APPEND,
 	OPCODE_SUBTRACT,
 	OPCODE_MULTIPLY,
 	OPCODE_DIVIDE,
@@ -28,7 +33,8 @@ typedef enum {
 	OPCODE_GREATER_THAN,
 	OPCODE_GREATER_THAN_OR_EQUAL,
 	OPCODE_INDEX,
-	OPCODE_INDEX_ASSIGN
+	OPCODE_INDEX_ASSIGN,
+	OPCODE_INDEX_ELEMENTS
 } opcode;
 
 typedef union {
@@ -37,3 +43,6 @@ typedef union {
 } bytecode;
 
 const char *opcode_repr(opcode op);
+
+// Returns how many `bytecode`s the instruction starting at `code` takes up, including its opcode.
+unsigned instruction_length(const bytecode *code);
@@ -0,0 +1,1091 @@
+#include "cache.h"
+#include "shared.h"
+#include "value.h"
+#include "globals.h"
+#include "builtin_function.h"
+#include "compile.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <setjmp.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/*
+ * Cache files and images are a sequence of 32-bit words in native byte order. Strings are prefixed
+ * by their length and padded to a whole number of words, and 64-bit numbers are stored as two words.
+ *
+ * The header contains everything the bytecode depends on besides the source code itself, so files
+ * from a different build of the interpreter are rejected.
+ */
+#define CACHE_FILE_MAGIC 0x43424d45 // "EMBC"
+#define IMAGE_FILE_MAGIC 0x4d494d45 // "EMIM"
+#define FILE_FORMAT_VERSION 1
+#define NUMBER_OF_OPCODES (OPCODE_INDEX_ELEMENTS + 1)
+
+// The magic number, version, number of opcodes, number of builtins, and total number of words.
+#define FILE_HEADER_LENGTH 5
+#define FILE_HEADER_TOTAL_LENGTH_INDEX 4
+
+enum {
+	CACHED_CONSTANT_NULL,
+	CACHED_CONSTANT_TRUE,
+	CACHED_CONSTANT_FALSE,
+	CACHED_CONSTANT_NUMBER,
+	CACHED_CONSTANT_STRING,
+
+	// Only in images: the value of a global, which is how folded functions are stored.
+	CACHED_CONSTANT_GLOBAL
+};
+
+static char *cache_file_path(unsigned long long source_hash) {
+	const char *directory = getenv("EMERALD_CACHE_DIR");
+
+	if (directory == NULL || *directory == '\0')
+		return NULL;
+
+	size_t length = strlen(directory) + sizeof("/0123456789abcdef.emc");
+	char *path = xmalloc(length);
+	snprintf(path, length, "%s/%016llx.emc", directory, source_hash);
+	return path;
+}
+
+bool has_global_operand(opcode op) {
+	switch (op) {
+	case OPCODE_LOAD_GLOBAL_VARIABLE:
+	case OPCODE_STORE_GLOBAL_VARIABLE:
+	case OPCODE_CALL_BUILTIN:
+	case OPCODE_LENGTH:
+	case OPCODE_TYPEOF:
+		return true;
+
+	default:
+		return false;
+	}
+}
+
+/*
+ * The VM trusts its bytecode completely, as it normally comes straight from the compiler. Bytecode
+ * from cache files and images is checked first instead: all its instructions have to exist, and
+ * their operands have to be in range.
+ */
+
+// Returns whether the operand at `offset` within the instruction starting at `code` is a local.
+static bool is_local_operand(const bytecode *code, unsigned offset) {
+	switch (code[0].op) {
+	case OPCODE_JUMP:
+		return false;
+
+	case OPCODE_JUMP_IF_TRUE:
+	case OPCODE_JUMP_IF_FALSE:
+		return offset == 1;
+
+	case OPCODE_ARRAY_LITERAL:
+	case OPCODE_LOAD_CONSTANT:
+	case OPCODE_LOAD_GLOBAL_VARIABLE:
+	case OPCODE_STORE_GLOBAL_VARIABLE:
+	case OPCODE_LENGTH:
+	case OPCODE_TYPEOF:
+	case OPCODE_INDEX_ELEMENTS:
+		return offset >= 2;
+
+	case OPCODE_CALL:
+		return offset != 2;
+
+	case OPCODE_CALL_BUILTIN:
+		return offset >= 4;
+
+	default:
+		return true;
+	}
+}
+
+// Returns whether the instruction stores its result in its last operand, which is always a local.
+static bool has_result(opcode op) {
+	return op != OPCODE_JUMP && op != OPCODE_JUMP_IF_TRUE && op != OPCODE_JUMP_IF_FALSE && op != OPCODE_RETURN;
+}
+
+static bool is_jump(opcode op) {
+	return op == OPCODE_JUMP || op == OPCODE_JUMP_IF_TRUE || op == OPCODE_JUMP_IF_FALSE;
+}
+
+// The target of the jump starting at `code`.
+static unsigned jump_target(const bytecode *code) {
+	return code[code[0].op == OPCODE_JUMP ? 1 : 2].count;
+}
+
+#define NO_LOCAL_SET ((unsigned) -1)
+#define LOCALS_PER_WORD 64
+
+static bool is_local_set(const uint64_t *set, unsigned local) {
+	return set[local / LOCALS_PER_WORD] >> (local % LOCALS_PER_WORD) & 1;
+}
+
+static void set_local(uint64_t *set, unsigned local) {
+	set[local / LOCALS_PER_WORD] |= (uint64_t) 1 << (local % LOCALS_PER_WORD);
+}
+
+// Removes the locals that aren't in `other` from `set`, returning whether there were any.
+static bool intersect_local_sets(uint64_t *set, const uint64_t *other, unsigned number_of_words) {
+	bool has_changed = false;
+
+	for (unsigned i = 0; i < number_of_words; i++) {
+		has_changed |= (set[i] & ~other[i]) != 0;
+		set[i] &= other[i];
+	}
+
+	return has_changed;
+}
+
+/*
+ * Returns whether every local's set before it's used, however the code gets there. This tracks the
+ * locals that are definitely set at each point: each jump target starts off with every local set,
+ * and is narrowed down to what's set at each of the jumps to it, until nothing changes any more.
+ * The code must have already been checked by `is_valid_code`.
+ */
+static bool are_locals_set_before_use(
+	const bytecode *code,
+	unsigned code_length,
+	unsigned number_of_locals,
+	unsigned number_of_arguments
+) {
+	unsigned number_of_words = number_of_locals / LOCALS_PER_WORD + 1;
+
+	// The index of each jump target's set of locals, which is `NO_LOCAL_SET` for everything else.
+	unsigned *local_set_indices = xmalloc((code_length + 1) * sizeof(unsigned));
+	unsigned number_of_targets = 0;
+
+	for (unsigned ip = 0; ip <= code_length; ip++)
+		local_set_indices[ip] = NO_LOCAL_SET;
+
+	for (unsigned ip = 0; ip < code_length; ip += instruction_length(&code[ip])) {
+		if (is_jump(code[ip].op) && local_set_indices[jump_target(&code[ip])] == NO_LOCAL_SET)
+			local_set_indices[jump_target(&code[ip])] = number_of_targets++;
+	}
+
+	// The targets' sets are followed by the set at the current instruction.
+	uint64_t *local_sets = xmalloc((number_of_targets + 1) * number_of_words * sizeof(uint64_t));
+	uint64_t *current = &local_sets[number_of_targets * number_of_words];
+	memset(local_sets, 0xff, number_of_targets * number_of_words * sizeof(uint64_t));
+
+	bool is_valid = true;
+	bool has_changed = true;
+
+	// Sets only ever shrink, so a local that isn't set on one pass won't be on the last one either.
+	while (is_valid && has_changed) {
+		has_changed = false;
+
+		// Only the arguments are set to begin with, which follow `CODEBLOCK_RETURN_LOCAL`.
+		memset(current, 0, number_of_words * sizeof(uint64_t));
+		for (unsigned i = 0; i < number_of_arguments; i++)
+			set_local(current, i + 1);
+
+		for (unsigned ip = 0; is_valid; ip += instruction_length(&code[ip])) {
+			if (local_set_indices[ip] != NO_LOCAL_SET)
+				intersect_local_sets(current, &local_sets[local_set_indices[ip] * number_of_words], number_of_words);
+
+			// Running off the end returns, just like `OPCODE_RETURN`.
+			if (ip == code_length || code[ip].op == OPCODE_RETURN) {
+				is_valid = is_local_set(current, CODEBLOCK_RETURN_LOCAL);
+
+				if (ip == code_length)
+					break;
+			}
+
+			unsigned length = instruction_length(&code[ip]);
+			unsigned last_read = has_result(code[ip].op) ? length - 1 : length;
+
+			for (unsigned i = 1; is_valid && i < last_read; i++) {
+				if (is_local_operand(&code[ip], i))
+					is_valid = is_local_set(current, code[ip + i].count);
+			}
+
+			if (has_result(code[ip].op))
+				set_local(current, code[ip + length - 1].count);
+
+			if (is_jump(code[ip].op)) {
+				uint64_t *target = &local_sets[local_set_indices[jump_target(&code[ip])] * number_of_words];
+				has_changed |= intersect_local_sets(target, current, number_of_words);
+			}
+
+			// Nothing falls through to the next instruction, so it can only be jumped to.
+			if (code[ip].op == OPCODE_JUMP || code[ip].op == OPCODE_RETURN)
+				memset(current, 0xff, number_of_words * sizeof(uint64_t));
+		}
+	}
+
+	free(local_set_indices);
+	free(local_sets);
+	return is_valid;
+}
+
+// Returns whether `code` can be run safely. Global operands are checked against `number_of_globals`,
+// which is the number of names following the code in cache files, and of global variables in images.
+static bool is_valid_code(
+	const bytecode *code,
+	unsigned code_length,
+	unsigned number_of_locals,
+	unsigned number_of_constants,
+	unsigned number_of_arguments,
+	unsigned number_of_globals
+) {
+	// The return value and arguments are always the first locals, and every other local's the
+	// result of some instruction. The locals are on the stack, so this also keeps them bounded.
+	if (number_of_locals <= number_of_arguments || number_of_locals - number_of_arguments - 1 > code_length)
+		return false;
+
+	// Jumps have to land on the start of an instruction, or just past the end of the code.
+	bool *is_instruction_start = xmalloc((code_length + 1) * sizeof(bool));
+	for (unsigned ip = 0; ip <= code_length; ip++)
+		is_instruction_start[ip] = ip == code_length;
+
+	bool is_valid = true;
+
+	for (unsigned ip = 0; ip < code_length; ip += instruction_length(&code[ip])) {
+		if (code[ip].count >= NUMBER_OF_OPCODES) {
+			is_valid = false;
+			break;
+		}
+
+		// The lengths of these depend on a count, which `instruction_length` doesn't check.
+		unsigned count_operand = 0;
+		switch (code[ip].op) {
+		case OPCODE_ARRAY_LITERAL:
+		case OPCODE_INDEX_ELEMENTS: count_operand = 1; break;
+		case OPCODE_CALL:           count_operand = 2; break;
+		case OPCODE_CALL_BUILTIN:   count_operand = 3; break;
+		default: break;
+		}
+
+		if (count_operand != 0 && (code_length - ip <= count_operand || code[ip + count_operand].count > code_length)) {
+			is_valid = false;
+			break;
+		}
+
+		if (code_length - ip < instruction_length(&code[ip])) {
+			is_valid = false;
+			break;
+		}
+
+		is_instruction_start[ip] = true;
+	}
+
+	for (unsigned ip = 0; is_valid && ip < code_length; ip += instruction_length(&code[ip])) {
+		const bytecode *operands = &code[ip + 1];
+
+		switch (code[ip].op) {
+		case OPCODE_LOAD_CONSTANT:
+			is_valid = operands[0].count < number_of_constants;
+			break;
+
+		case OPCODE_LOAD_GLOBAL_VARIABLE:
+		case OPCODE_STORE_GLOBAL_VARIABLE:
+		case OPCODE_LENGTH:
+		case OPCODE_TYPEOF:
+			is_valid = operands[0].count < number_of_globals;
+			break;
+
+		// Builtins are called with exactly the arguments they take, without checking.
+		case OPCODE_CALL_BUILTIN:
+			is_valid = operands[0].count < number_of_globals
+				&& operands[1].count < NUMBER_OF_BUILTIN_FUNCTIONS
+				&& operands[2].count == builtin_functions[operands[1].count].required_argument_count;
+			break;
+
+		case OPCODE_JUMP:
+		case OPCODE_JUMP_IF_TRUE:
+		case OPCODE_JUMP_IF_FALSE:
+			is_valid = jump_target(&code[ip]) <= code_length && is_instruction_start[jump_target(&code[ip])];
+			break;
+
+		default:
+			break;
+		}
+
+		for (unsigned i = 1; is_valid && i < instruction_length(&code[ip]); i++) {
+			if (is_local_operand(&code[ip], i))
+				is_valid = code[ip + i].count < number_of_locals;
+		}
+	}
+
+	free(is_instruction_start);
+	return is_valid;
+}
+
+codeblock *link_cached_body(cached_body *body) {
+	codeblock *block = body->block;
+	unsigned *global_indices = xmalloc(body->number_of_globals * sizeof(unsigned));
+
+	for (unsigned i = 0; i < body->number_of_globals; i++) {
+		int global_index = lookup_global_variable(body->global_names[i]);
+
+		if (global_index == GLOBAL_DOESNT_EXIST)
+			die("undeclared variable '%s'", symbol_name(body->global_names[i]));
+
+		global_indices[i] = global_index;
+	}
+
+	for (unsigned ip = 0; ip < block->code_length; ip += instruction_length(&block->code[ip])) {
+		if (has_global_operand(block->code[ip].op))
+			block->code[ip + 1].count = global_indices[block->code[ip + 1].count];
+	}
+
+	free(global_indices);
+	free(body->global_names);
+	free(body);
+	return block;
+}
+
+void free_cached_body(cached_body *body) {
+	free(body->global_names);
+	free_codeblock(body->block);
+	free(body);
+}
+
+/** Reading **/
+
+struct cache_reader {
+	const char *path;
+	const uint32_t *words;
+	size_t length, position;
+
+	// Where to jump to if the file's corrupt, which is set while checking cache files so that
+	// they're ignored instead. Otherwise it's `NULL`, and corruption is fatal.
+	jmp_buf *on_corrupt;
+};
+
+static _Noreturn void corrupt(cache_reader *reader) {
+	if (reader->on_corrupt != NULL)
+		longjmp(*reader->on_corrupt, 1);
+
+	die("corrupt %s '%s'", reader->words[0] == IMAGE_FILE_MAGIC ? "image" : "cache file", reader->path);
+}
+
+static uint32_t read_word(cache_reader *reader) {
+	if (reader->position == reader->length)
+		corrupt(reader);
+
+	return reader->words[reader->position++];
+}
+
+static const uint32_t *read_words(cache_reader *reader, size_t amount) {
+	if (reader->length - reader->position < amount)
+		corrupt(reader);
+
+	const uint32_t *words = &reader->words[reader->position];
+	reader->position += amount;
+	return words;
+}
+
+static uint64_t read_doubleword(cache_reader *reader) {
+	uint64_t low = read_word(reader);
+	return low | (uint64_t) read_word(reader) << 32;
+}
+
+static char *read_string(cache_reader *reader, unsigned *length_out) {
+	unsigned length = read_word(reader);
+	const char *bytes = (const char *) read_words(reader, length / sizeof(uint32_t) + 1);
+
+	char *str = xmalloc(length + 1);
+	memcpy(str, bytes, length);
+	str[length] = '\0';
+
+	if (length_out != NULL)
+		*length_out = length;
+
+	return str;
+}
+
+// Returns the bytes of the name of a function or variable, which is never empty and never contains
+// nul bytes. Unlike strings, they aren't copied.
+static const char *read_name(cache_reader *reader, unsigned *length) {
+	*length = read_word(reader);
+	const char *name = (const char *) read_words(reader, *length / sizeof(uint32_t) + 1);
+
+	if (*length == 0 || memchr(name, '\0', *length) != NULL)
+		corrupt(reader);
+
+	return name;
+}
+
+static symbol read_symbol(cache_reader *reader) {
+	unsigned length;
+	const char *name = read_name(reader, &length);
+	return intern_symbol(name, length);
+}
+
+// Reads the number of things that follow, each of which takes up at least `minimum_length` words.
+// It's checked before anything's allocated for them, so a corrupt count can't exhaust memory.
+static unsigned read_count(cache_reader *reader, size_t minimum_length) {
+	unsigned count = read_word(reader);
+
+	if ((reader->length - reader->position) / minimum_length < count)
+		corrupt(reader);
+
+	return count;
+}
+
+static value read_constant(cache_reader *reader) {
+	switch (read_word(reader)) {
+	case CACHED_CONSTANT_NULL:   return VALUE_NULL;
+	case CACHED_CONSTANT_TRUE:   return VALUE_TRUE;
+	case CACHED_CONSTANT_FALSE:  return VALUE_FALSE;
+	case CACHED_CONSTANT_NUMBER: return new_number_value((number) read_doubleword(reader));
+
+	case CACHED_CONSTANT_STRING: {
+		unsigned length;
+		char *str = read_string(reader, &length);
+		value interned = intern_string_value(str, length);
+		free(str);
+		return interned;
+	}
+
+	case CACHED_CONSTANT_GLOBAL: {
+		unsigned global_index = read_word(reader);
+
+		if (global_index >= number_of_global_variables())
+			corrupt(reader);
+
+		return clone_value(peek_global_variable(global_index));
+	}
+
+	default:
+		corrupt(reader);
+	}
+}
+
+// Reads a codeblock without checking its code, which is up to the caller.
+static codeblock *read_codeblock(cache_reader *reader) {
+	unsigned number_of_locals = read_word(reader);
+	unsigned code_length = read_word(reader);
+	const uint32_t *words = read_words(reader, code_length);
+
+	bytecode *code = xmalloc(code_length * sizeof(bytecode));
+	memcpy(code, words, code_length * sizeof(bytecode));
+
+	unsigned number_of_constants = read_count(reader, 1);
+	value *constants = xmalloc(number_of_constants * sizeof(value));
+	for (unsigned i = 0; i < number_of_constants; i++)
+		constants[i] = read_constant(reader);
+
+	return new_codeblock(number_of_locals, code_length, code, number_of_constants, constants);
+}
+
+static cached_body *read_cached_body(cache_reader *reader) {
+	cached_body *body = xmalloc(sizeof(cached_body));
+	body->block = read_codeblock(reader);
+	body->number_of_globals = read_count(reader, 2);
+	body->global_names = xmalloc(body->number_of_globals * sizeof(symbol));
+
+	for (unsigned i = 0; i < body->number_of_globals; i++)
+		body->global_names[i] = read_symbol(reader);
+
+	return body;
+}
+
+static void skip_string(cache_reader *reader) {
+	unsigned length = read_word(reader);
+	read_words(reader, length / sizeof(uint32_t) + 1);
+}
+
+static void skip_name(cache_reader *reader) {
+	unsigned length;
+	(void) read_name(reader, &length);
+}
+
+static void skip_cached_constant(cache_reader *reader) {
+	switch (read_word(reader)) {
+	case CACHED_CONSTANT_NULL:
+	case CACHED_CONSTANT_TRUE:
+	case CACHED_CONSTANT_FALSE:
+		break;
+
+	case CACHED_CONSTANT_NUMBER:
+		read_words(reader, 2);
+		break;
+
+	case CACHED_CONSTANT_STRING:
+		skip_string(reader);
+		break;
+
+	default: // including `CACHED_CONSTANT_GLOBAL`, which is only in images.
+		corrupt(reader);
+	}
+}
+
+// Checks the function declaration that's next in the file, without loading anything.
+static void check_cached_function(cache_reader *reader) {
+	skip_name(reader);
+	read_word(reader); // the line number
+
+	unsigned number_of_arguments = read_word(reader);
+	for (unsigned i = 0; i < number_of_arguments; i++)
+		skip_name(reader);
+
+	unsigned number_of_locals = read_word(reader);
+	unsigned code_length = read_word(reader);
+	const bytecode *code = (const bytecode *) read_words(reader, code_length);
+
+	unsigned number_of_constants = read_word(reader);
+	for (unsigned i = 0; i < number_of_constants; i++)
+		skip_cached_constant(reader);
+
+	unsigned number_of_globals = read_word(reader);
+	for (unsigned i = 0; i < number_of_globals; i++)
+		skip_name(reader);
+
+	if (!is_valid_code(code, code_length, number_of_locals, number_of_constants, number_of_arguments, number_of_globals))
+		corrupt(reader);
+
+	// The compiler doesn't rule this out entirely (`hedgehog u = u` uses `u` before it's set), so
+	// images aren't checked for it. Cache files can simply be ignored, which runs the same code.
+	if (!are_locals_set_before_use(code, code_length, number_of_locals, number_of_arguments))
+		corrupt(reader);
+}
+
+// Checks every declaration in the file before any of them are loaded, as loading them has side
+// effects that couldn't be undone if a later one turned out to be corrupt.
+static bool is_valid_cache_file(cache_reader *reader) {
+	size_t start = reader->position;
+	jmp_buf on_corrupt;
+
+	if (setjmp(on_corrupt)) {
+		reader->on_corrupt = NULL;
+		return false;
+	}
+
+	reader->on_corrupt = &on_corrupt;
+
+	while (reader->position != reader->length) {
+		switch (read_word(reader)) {
+		case CACHED_DECLARATION_IMPORT:
+			skip_string(reader);
+			break;
+
+		case CACHED_DECLARATION_GLOBAL:
+			skip_name(reader);
+			break;
+
+		case CACHED_DECLARATION_FUNCTION:
+			check_cached_function(reader);
+			break;
+
+		default:
+			corrupt(reader);
+		}
+	}
+
+	reader->on_corrupt = NULL;
+	reader->position = start;
+	return true;
+}
+
+// Maps the file at `path`, checking that its header matches `magic` and this build of the
+// interpreter. Ownership of `path` is given to the reader; on failure `NULL` is returned instead.
+static cache_reader *open_reader(char *path, uint32_t magic, size_t header_length) {
+	int fd = open(path, O_RDONLY);
+	if (fd == -1) {
+		LOG("unable to open '%s': %s", path, strerror(errno));
+		free(path);
+		return NULL;
+	}
+
+	struct stat info;
+	const uint32_t *words = MAP_FAILED;
+
+	if (fstat(fd, &info) == 0 && info.st_size >= (off_t) (header_length * 4) && info.st_size % 4 == 0)
+		words = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+
+	if (words == MAP_FAILED) {
+		LOG("unable to map '%s'", path);
+		free(path);
+		return NULL;
+	}
+
+	if (words[0] != magic
+		|| words[1] != FILE_FORMAT_VERSION
+		|| words[2] != NUMBER_OF_OPCODES
+		|| words[3] != NUMBER_OF_BUILTIN_FUNCTIONS
+		|| words[FILE_HEADER_TOTAL_LENGTH_INDEX] != info.st_size / 4
+	) {
+		LOG("'%s' is for a different build of the interpreter", path);
+		munmap((void *) words, info.st_size);
+		free(path);
+		return NULL;
+	}
+
+	cache_reader *reader = xmalloc(sizeof(cache_reader));
+	reader->path = path;
+	reader->words = words;
+	reader->length = info.st_size / 4;
+	reader->position = FILE_HEADER_LENGTH;
+	reader->on_corrupt = NULL;
+
+	return reader;
+}
+
+cache_reader *open_cache_file(unsigned long long source_hash, size_t source_length) {
+	char *path = cache_file_path(source_hash);
+	if (path == NULL)
+		return NULL;
+
+	cache_reader *reader = open_reader(path, CACHE_FILE_MAGIC, FILE_HEADER_LENGTH + 3);
+	if (reader == NULL)
+		return NULL;
+
+	// Different source code can have the same hash, though it's unlikely.
+	if (read_doubleword(reader) != source_hash || read_word(reader) != source_length) {
+		LOG("ignoring cache file '%s' for different source code", reader->path);
+		close_cache_file(reader);
+		return NULL;
+	}
+
+	// The source's recompiled instead, which replaces the cache file.
+	if (!is_valid_cache_file(reader)) {
+		LOG("ignoring corrupt cache file '%s'", reader->path);
+		close_cache_file(reader);
+		return NULL;
+	}
+
+	LOG("loading cache file '%s'", reader->path);
+	return reader;
+}
+
+bool read_cached_declaration(cache_reader *reader, cached_declaration *declaration) {
+	if (reader->position == reader->length)
+		return false;
+
+	declaration->kind = read_word(reader);
+
+	switch (declaration->kind) {
+	case CACHED_DECLARATION_IMPORT:
+		declaration->path = read_string(reader, NULL);
+		break;
+
+	case CACHED_DECLARATION_GLOBAL:
+		declaration->name = read_symbol(reader);
+		break;
+
+	case CACHED_DECLARATION_FUNCTION:
+		declaration->name = read_symbol(reader);
+		declaration->source_line_number = read_word(reader);
+		declaration->number_of_arguments = read_count(reader, 2);
+		declaration->argument_names = xmalloc(declaration->number_of_arguments * sizeof(symbol));
+
+		for (unsigned i = 0; i < declaration->number_of_arguments; i++)
+			declaration->argument_names[i] = read_symbol(reader);
+
+		declaration->body = read_cached_body(reader);
+		break;
+
+	default:
+		corrupt(reader);
+	}
+
+	return true;
+}
+
+void close_cache_file(cache_reader *reader) {
+	munmap((void *) reader->words, reader->length * 4);
+	free((char *) reader->path);
+	free(reader);
+}
+
+/** Writing **/
+
+struct cache_writer {
+	char *path;
+	uint32_t *words;
+	size_t length, capacity;
+};
+
+static void write_word(cache_writer *writer, uint32_t word) {
+	if (writer->length == writer->capacity) {
+		writer->capacity *= 2;
+		writer->words = xrealloc(writer->words, writer->capacity * sizeof(uint32_t));
+	}
+
+	writer->words[writer->length++] = word;
+}
+
+static void write_doubleword(cache_writer *writer, uint64_t doubleword) {
+	write_word(writer, (uint32_t) doubleword);
+	write_word(writer, (uint32_t) (doubleword >> 32));
+}
+
+static void write_string(cache_writer *writer, const char *str, unsigned length) {
+	write_word(writer, length);
+
+	// Always pad with at least one nul byte, which keeps `read_string` simple.
+	for (unsigned i = 0; i < length / sizeof(uint32_t) + 1; i++) {
+		uint32_t word = 0;
+		unsigned amount = length - i * sizeof(uint32_t);
+
+		memcpy(&word, &str[i * sizeof(uint32_t)], amount < sizeof(uint32_t) ? amount : sizeof(uint32_t));
+		write_word(writer, word);
+	}
+}
+
+static void write_symbol(cache_writer *writer, symbol sym) {
+	const char *name = symbol_name(sym);
+	write_string(writer, name, strlen(name));
+}
+
+// Returns the index of the global holding `func`, which is a function or builtin function.
+static unsigned global_index_of(value func) {
+	int global_index = is_builtin_function(func)
+		? as_builtin_function(func) - builtin_functions
+		: lookup_global_variable_by_name(as_function(func)->function_name);
+
+	if (global_index == GLOBAL_DOESNT_EXIST || peek_global_variable(global_index) != func)
+		bug("function isn't the value of its global");
+
+	return global_index;
+}
+
+static void write_constant(cache_writer *writer, value constant) {
+	switch (classify(constant)) {
+	case VALUE_KIND_NULL:
+		write_word(writer, CACHED_CONSTANT_NULL);
+		break;
+
+	case VALUE_KIND_BOOLEAN:
+		write_word(writer, as_boolean(constant) ? CACHED_CONSTANT_TRUE : CACHED_CONSTANT_FALSE);
+		break;
+
+	case VALUE_KIND_NUMBER:
+		write_word(writer, CACHED_CONSTANT_NUMBER);
+		write_doubleword(writer, (uint64_t) as_number(constant));
+		break;
+
+	case VALUE_KIND_STRING: {
+		string_contents contents;
+		get_string_contents(constant, &contents);
+
+		write_word(writer, CACHED_CONSTANT_STRING);
+		write_string(writer, contents.ptr, contents.length);
+		break;
+	}
+
+	case VALUE_KIND_FUNCTION:
+	case VALUE_KIND_BUILTIN_FUNCTION:
+		// Cache files are written before globals are folded, so only images have these. They're
+		// always the value of the global of the same name.
+		write_word(writer, CACHED_CONSTANT_GLOBAL);
+		write_word(writer, global_index_of(constant));
+		break;
+
+	default:
+		bug("cannot cache a constant %s", value_name(constant));
+	}
+}
+
+static void write_codeblock(cache_writer *writer, const codeblock *block) {
+	write_word(writer, block->number_of_locals);
+	write_word(writer, block->code_length);
+
+	for (unsigned i = 0; i < block->code_length; i++)
+		write_word(writer, block->code[i].count);
+
+	write_word(writer, block->number_of_constants);
+	for (unsigned i = 0; i < block->number_of_constants; i++)
+		write_constant(writer, block->constants[i]);
+}
+
+static cache_writer *new_writer(char *path, uint32_t magic) {
+	cache_writer *writer = xmalloc(sizeof(cache_writer));
+	writer->path = path;
+	writer->length = 0;
+	writer->capacity = 256;
+	writer->words = xmalloc(writer->capacity * sizeof(uint32_t));
+
+	write_word(writer, magic);
+	write_word(writer, FILE_FORMAT_VERSION);
+	write_word(writer, NUMBER_OF_OPCODES);
+	write_word(writer, NUMBER_OF_BUILTIN_FUNCTIONS);
+	write_word(writer, 0); // the total number of words, which is filled in by `commit_file`.
+
+	return writer;
+}
+
+// Writes out `writer`'s contents, returning false (with `errno` set) if that isn't possible.
+static bool commit_file(cache_writer *writer) {
+	writer->words[FILE_HEADER_TOTAL_LENGTH_INDEX] = writer->length;
+
+	// Write to a temporary file first, so other processes never see a partially-written file.
+	size_t temporary_path_length = strlen(writer->path) + sizeof(".XXXXXX");
+	char temporary_path[temporary_path_length];
+	snprintf(temporary_path, temporary_path_length, "%s.XXXXXX", writer->path);
+
+	int fd = mkstemp(temporary_path);
+	if (fd == -1)
+		return false;
+
+	(void) fchmod(fd, 0644); // `mkstemp` only makes it readable by us.
+
+	size_t size = writer->length * sizeof(uint32_t);
+	bool wrote_everything = write(fd, writer->words, size) == (ssize_t) size;
+	close(fd);
+
+	if (!wrote_everything || rename(temporary_path, writer->path) == -1) {
+		int error = errno;
+		unlink(temporary_path);
+		errno = error;
+		return false;
+	}
+
+	return true;
+}
+
+cache_writer *create_cache_file(unsigned long long source_hash, size_t source_length) {
+	char *path = cache_file_path(source_hash);
+	if (path == NULL)
+		return NULL;
+
+	cache_writer *writer = new_writer(path, CACHE_FILE_MAGIC);
+	write_doubleword(writer, source_hash);
+	write_word(writer, source_length);
+	return writer;
+}
+
+void write_cached_global(cache_writer *writer, symbol name) {
+	write_word(writer, CACHED_DECLARATION_GLOBAL);
+	write_symbol(writer, name);
+}
+
+void write_cached_import(cache_writer *writer, const char *path) {
+	write_word(writer, CACHED_DECLARATION_IMPORT);
+	write_string(writer, path, strlen(path));
+}
+
+void write_cached_function(
+	cache_writer *writer,
+	symbol name,
+	unsigned number_of_arguments,
+	const symbol *argument_names,
+	unsigned source_line_number,
+	const codeblock *body
+) {
+	write_word(writer, CACHED_DECLARATION_FUNCTION);
+	write_symbol(writer, name);
+	write_word(writer, source_line_number);
+	write_word(writer, number_of_arguments);
+
+	for (unsigned i = 0; i < number_of_arguments; i++)
+		write_symbol(writer, argument_names[i]);
+
+	write_word(writer, body->number_of_locals);
+	write_word(writer, body->code_length);
+
+	// Global operands are replaced with indices into the list of global names following the code.
+	unsigned number_of_globals = 0;
+	unsigned global_indices[body->code_length];
+
+	for (unsigned ip = 0; ip < body->code_length; ip += instruction_length(&body->code[ip])) {
+		unsigned length = instruction_length(&body->code[ip]);
+
+		if (!has_global_operand(body->code[ip].op)) {
+			for (unsigned i = 0; i < length; i++)
+				write_word(writer, body->code[ip + i].count);
+			continue;
+		}
+
+		unsigned global_index = body->code[ip + 1].count;
+		unsigned name_index = 0;
+
+		while (name_index < number_of_globals && global_indices[name_index] != global_index)
+			name_index++;
+
+		if (name_index == number_of_globals)
+			global_indices[number_of_globals++] = global_index;
+
+		write_word(writer, body->code[ip].op);
+		write_word(writer, name_index);
+		for (unsigned i = 2; i < length; i++)
+			write_word(writer, body->code[ip + i].count);
+	}
+
+	write_word(writer, body->number_of_constants);
+	for (unsigned i = 0; i < body->number_of_constants; i++)
+		write_constant(writer, body->constants[i]);
+
+	write_word(writer, number_of_globals);
+	for (unsigned i = 0; i < number_of_globals; i++) {
+		const char *global_name = global_variable_name(global_indices[i]);
+		write_string(writer, global_name, strlen(global_name));
+	}
+}
+
+void commit_cache_file(cache_writer *writer) {
+	if (commit_file(writer))
+		LOG("wrote cache file '%s'", writer->path);
+	else
+		LOG("unable to write cache file '%s': %s", writer->path, strerror(errno));
+
+	discard_cache_file(writer);
+}
+
+void discard_cache_file(cache_writer *writer) {
+	free(writer->path);
+	free(writer->words);
+	free(writer);
+}
+
+/** Images **/
+
+enum {
+	IMAGE_GLOBAL_NULL,
+	IMAGE_GLOBAL_BUILTIN_FUNCTION,
+	IMAGE_GLOBAL_FUNCTION
+};
+
+void write_image(const char *path) {
+	unsigned number_of_globals = number_of_global_variables();
+
+	// Bodies are normally compiled when they're first called, but an image needs all of them.
+	for (unsigned i = 0; i < number_of_globals; i++) {
+		value global = peek_global_variable(i);
+
+		if (is_function(global) && as_function(global)->body == NULL)
+			compile_function_body(as_function(global));
+	}
+
+	cache_writer *writer = new_writer(strdup(path), IMAGE_FILE_MAGIC);
+	write_word(writer, number_of_globals);
+
+	// All the globals come first, as functions' constants can refer to any of them.
+	for (unsigned i = 0; i < number_of_globals; i++) {
+		const char *name = global_variable_name(i);
+		value global = peek_global_variable(i);
+
+		write_string(writer, name, strlen(name));
+		write_word(writer, is_global_variable_reassigned(i));
+
+		if (global == VALUE_NULL) {
+			write_word(writer, IMAGE_GLOBAL_NULL);
+		} else if (is_builtin_function(global)) {
+			write_word(writer, IMAGE_GLOBAL_BUILTIN_FUNCTION);
+		} else if (is_function(global)) {
+			function *func = as_function(global);
+
+			write_word(writer, IMAGE_GLOBAL_FUNCTION);
+			write_word(writer, func->source_line_number);
+			write_string(writer, func->source_filename, strlen(func->source_filename));
+			write_word(writer, func->number_of_arguments);
+
+			for (unsigned j = 0; j < func->number_of_arguments; j++)
+				write_symbol(writer, func->argument_names[j]);
+		} else {
+			bug("global %s is a %s before the program's started", name, value_name(global));
+		}
+	}
+
+	for (unsigned i = 0; i < number_of_globals; i++) {
+		value global = peek_global_variable(i);
+
+		if (is_function(global))
+			write_codeblock(writer, as_function(global)->body);
+	}
+
+	if (!commit_file(writer))
+		die("unable to write image '%s': %s", path, strerror(errno));
+
+	discard_cache_file(writer);
+}
+
+// Functions' filenames are never freed, so the ones from images are kept here. (Otherwise, the
+// functions themselves are the only things referring to them.)
+static struct {
+	unsigned length, capacity;
+	char **filenames;
+} image_filenames;
+
+static const char *keep_image_filename(char *filename) {
+	if (image_filenames.length == image_filenames.capacity) {
+		image_filenames.capacity = image_filenames.capacity * 2 + 1;
+		image_filenames.filenames = xrealloc(image_filenames.filenames, image_filenames.capacity * sizeof(char *));
+	}
+
+	image_filenames.filenames[image_filenames.length++] = filename;
+	return filename;
+}
+
+void load_image(const char *path) {
+	cache_reader *reader = open_reader(strdup(path), IMAGE_FILE_MAGIC, FILE_HEADER_LENGTH + 1);
+	if (reader == NULL)
+		die("unable to load image '%s': it's missing or for a different build of the interpreter", path);
+
+	unsigned number_of_globals = read_word(reader);
+	const char *source_filename = NULL;
+
+	for (unsigned i = 0; i < number_of_globals; i++) {
+		symbol name = read_symbol(reader);
+		bool is_reassigned = read_word(reader);
+		unsigned kind = read_word(reader);
+
+		// Builtin functions are always the first globals, so they're simply checked.
+		if (i < NUMBER_OF_BUILTIN_FUNCTIONS) {
+			if (kind != IMAGE_GLOBAL_BUILTIN_FUNCTION || lookup_global_variable(name) != (int) i)
+				die("corrupt image '%s'", path);
+		} else if (declare_global_variable(name) != i) {
+			die("corrupt image '%s'", path);
+		}
+
+		if (is_reassigned)
+			mark_global_variable_reassigned(i);
+
+		if (kind != IMAGE_GLOBAL_FUNCTION)
+			continue;
+
+		unsigned source_line_number = read_word(reader);
+		char *filename = read_string(reader, NULL);
+
+		// Share filenames between functions where possible.
+		if (source_filename != NULL && !strcmp(filename, source_filename))
+			free(filename);
+		else
+			source_filename = keep_image_filename(filename);
+
+		unsigned number_of_arguments = read_count(reader, 2);
+		symbol *argument_names = xmalloc(number_of_arguments * sizeof(symbol));
+
+		for (unsigned j = 0; j < number_of_arguments; j++)
+			argument_names[j] = read_symbol(reader);
+
+		assign_global_variable(i, new_function_value(new_function(
+			global_variable_name(i),
+			NULL, // read once all the globals exist.
+			number_of_arguments,
+			argument_names,
+			source_line_number,
+			source_filename
+		)));
+	}
+
+	for (unsigned i = 0; i < number_of_globals; i++) {
+		value global = peek_global_variable(i);
+		if (!is_function(global))
+			continue;
+
+		function *func = as_function(global);
+		codeblock *body = func->body = read_codeblock(reader);
+
+		// Global operands are the globals' indices in images.
+		bool is_valid = is_valid_code(
+			body->code,
+			body->code_length,
+			body->number_of_locals,
+			body->number_of_constants,
+			func->number_of_arguments,
+			number_of_globals
+		);
+
+		if (!is_valid)
+			die("corrupt image '%s'", path);
+	}
+
+	close_cache_file(reader);
+}
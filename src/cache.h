@@ -0,0 +1,96 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "codeblock.h"
+#include "symbol.h"
+
+/*
+ * An on-disk cache of compiled files, which is enabled by setting `EMERALD_CACHE_DIR` to the
+ * directory to store it in. Cache files are keyed by a hash of the source code, and contain each of
+ * the source's declarations in order, with the functions' bodies already compiled.
+ *
+ * Since the indices of globals differ between runs, bytecode within cache files refers to globals
+ * by name. These are resolved to indices ("linked") when the function's first called, just like
+ * uncompiled functions are compiled when they're first called.
+ */
+
+// A function body that was loaded from a cache file but hasn't been linked yet.
+typedef struct {
+	// Global operands within `block->code` are indices into `global_names`.
+	codeblock *block;
+	unsigned number_of_globals;
+	symbol *global_names;
+} cached_body;
+
+// Returns true if `op`'s first operand is the index of a global variable.
+bool has_global_operand(opcode op);
+
+// Resolves `body`'s global names, returning the linked codeblock. `body` is freed.
+codeblock *link_cached_body(cached_body *body);
+void free_cached_body(cached_body *body);
+
+typedef enum {
+	CACHED_DECLARATION_IMPORT,
+	CACHED_DECLARATION_GLOBAL,
+	CACHED_DECLARATION_FUNCTION
+} cached_declaration_kind;
+
+typedef struct {
+	cached_declaration_kind kind;
+
+	// The path that's imported, for `CACHED_DECLARATION_IMPORT`s. Owned by the caller.
+	char *path;
+
+	// The name of the global or function, for the other kinds.
+	symbol name;
+
+	// Only for `CACHED_DECLARATION_FUNCTION`s; all of these are owned by the caller.
+	unsigned number_of_arguments;
+	symbol *argument_names;
+	unsigned source_line_number;
+	cached_body *body;
+} cached_declaration;
+
+typedef struct cache_reader cache_reader;
+typedef struct cache_writer cache_writer;
+
+// Opens the cache file for the source code with the given hash and length, returning `NULL` if
+// caching is disabled or there's no cache file for it. The whole file's checked first, so a corrupt
+// or stale one is ignored, like a missing one.
+cache_reader *open_cache_file(unsigned long long source_hash, size_t source_length);
+
+// Reads the next declaration into `declaration`, returning false once there are none left.
+bool read_cached_declaration(cache_reader *reader, cached_declaration *declaration);
+void close_cache_file(cache_reader *reader);
+
+// Starts a new cache file for the given source code, returning `NULL` if caching is disabled. Once
+// every declaration has been written, it must be either committed or discarded.
+cache_writer *create_cache_file(unsigned long long source_hash, size_t source_length);
+
+void write_cached_global(cache_writer *writer, symbol name);
+void write_cached_import(cache_writer *writer, const char *path);
+void write_cached_function(
+	cache_writer *writer,
+	symbol name,
+	unsigned number_of_arguments,
+	const symbol *argument_names,
+	unsigned source_line_number,
+	const codeblock *body
+);
+
+void commit_cache_file(cache_writer *writer);
+void discard_cache_file(cache_writer *writer);
+
+/*
+ * Images are a snapshot of every global after the program's been compiled, with all of the
+ * functions' bodies compiled and their constants folded. Starting from an image skips compiling
+ * entirely, which is useful for large programs that are deployed as a whole.
+ */
+
+// Writes an image of the current globals to `path`. This must be called after `fold_constant_globals`.
+void write_image(const char *path);
+
+// Loads the globals from the image at `path`. This must be called after `init_global_variables`, and
+// replaces compiling the program.
+void load_image(const char *path);
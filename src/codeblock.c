@@ -152,6 +152,39 @@ static void run_call(virtual_machine *vm) {
 
 	set_next_local(vm, call_value(function, arg_count, arguments));
 
+	free_value(function);
+	for (unsigned i = 0; i < arg_count; i++)
+		free_value(arguments[i]);
+}
+
+// Checks that the builtin a call was bound to at compile time is still in its global. If it's
+// been reassigned since, the call falls back to being a normal call to the new value.
+static bool is_still_builtin(unsigned global_index, builtin_function_index builtin_index) {
+	return peek_global_variable(global_index) == new_builtin_function_value(&builtin_functions[builtin_index]);
+}
+
+static value call_reassigned_global(unsigned global_index, unsigned arg_count, const value *arguments) {
+	value function = fetch_global_variable(global_index);
+	value ret = call_value(function, arg_count, arguments);
+	free_value(function);
+	return ret;
+}
+
+static void run_call_builtin(virtual_machine *vm) {
+	unsigned global_index = next_count(vm);
+	builtin_function_index builtin_index = next_count(vm);
+	unsigned arg_count = next_count(vm);
+	value arguments[arg_count + 1]; // see `compile_builtin_call`
+
+	for (unsigned i = 0; i < arg_count; i++)
+		arguments[i] = next_local(vm);
+
+	// No need to check the argument count, as the compiler only binds calls with the right amount.
+	if (is_still_builtin(global_index, builtin_index))
+		set_next_local(vm, (builtin_functions[builtin_index].function_pointer)(arguments));
+	else
+		set_next_local(vm, call_reassigned_global(global_index, arg_count, arguments));
+
 	for (unsigned i = 0; i < arg_count; i++)
 		free_value(arguments[i]);
 }
@@ -160,6 +193,30 @@ static void run_return(virtual_machine *vm) {
 	vm->instruction_pointer = (unsigned) -1; // set it to beyond the end.
 }
 
+static void run_length(virtual_machine *vm) {
+	unsigned global_index = next_count(vm);
+	value arg = next_local(vm);
+
+	if (is_still_builtin(global_index, BUILTIN_LENGTH))
+		set_next_local(vm, builtin_length(arg));
+	else
+		set_next_local(vm, call_reassigned_global(global_index, 1, &arg));
+
+	free_value(arg);
+}
+
+static void run_typeof(virtual_machine *vm) {
+	unsigned global_index = next_count(vm);
+	value arg = next_local(vm);
+
+	if (is_still_builtin(global_index, BUILTIN_TYPEOF))
+		set_next_local(vm, builtin_typeof(arg));
+	else
+		set_next_local(vm, call_reassigned_global(global_index, 1, &arg));
+
+	free_value(arg);
+}
+
 static void run_not(virtual_machine *vm) {
 	value arg = next_local(vm);
 
@@ -186,6 +243,20 @@ static void run_add(virtual_machine *vm) {
 	free_value(rhs);
 }
 
+// `local += rhs`, which leaves the sum in both `local` and the target. The local's value is taken
+// rather than cloned, so it can be appended to in place if nothing else refers to it.
+static void run_append(virtual_machine *vm) {
+	unsigned count = next_count(vm);
+	value lhs = vm->locals[count];
+	assert(lhs != VALUE_UNDEFINED);
+
+	value rhs = next_local(vm);
+	vm->locals[count] = append_values(lhs, rhs);
+	free_value(rhs);
+
+	set_next_local(vm, clone_value(vm->locals[count]));
+}
+
 static void run_subtract(virtual_machine *vm) {
 	value lhs = next_local(vm);
 	value rhs = next_local(vm);
@@ -309,6 +380,32 @@ static void run_index_assign(virtual_machine *vm) {
 	// don't free `val` as we used it in `set_next_local`.
 }
 
+// Indexes into an array that was never allocated; its elements are stored in separate locals.
+static void run_index_elements(virtual_machine *vm) {
+	unsigned length = next_count(vm);
+	unsigned first_element = vm->instruction_pointer;
+
+	vm->instruction_pointer += length; // skip the elements, we only need the chosen one.
+	value index = next_local(vm);
+
+	if (!is_number(index))
+		die_with_stacktrace("you must index with numbers, not %s", value_name(index));
+
+	number num_idx = as_number(index);
+	int idx = num_idx;
+
+	if (idx < 0)
+		idx += length;
+
+	if (idx < 0 || length <= (unsigned) idx)
+		die_with_stacktrace("index %lld out of bounds for array of length %u", num_idx, length);
+
+	value element = vm->locals[vm->block->code[first_element + idx].count];
+	assert(element != VALUE_UNDEFINED);
+
+	set_next_local(vm, clone_value(element));
+}
+
 static void run_vm(virtual_machine *vm) {
 	while (vm->instruction_pointer < vm->block->code_length) {
 		switch (next_opcode(vm)) {
@@ -323,11 +420,16 @@ static void run_vm(virtual_machine *vm) {
 		case OPCODE_JUMP_IF_FALSE: run_jump_if_false(vm); break;
 		case OPCODE_JUMP:          run_jump(vm); break;
 		case OPCODE_CALL:          run_call(vm); break;
+		case OPCODE_CALL_BUILTIN:  run_call_builtin(vm); break;
 		case OPCODE_RETURN:        run_return(vm); break;
 
+		case OPCODE_LENGTH: run_length(vm); break;
+		case OPCODE_TYPEOF: run_typeof(vm); break;
+
 		case OPCODE_NOT:      run_not(vm); break;
 		case OPCODE_NEGATE:   run_negate(vm); break;
 		case OPCODE_ADD:      run_add(vm); break;
+		case OPCODE_APPEND:   run_append(vm); break;
 		case OPCODE_SUBTRACT: run_subtract(vm); break;
 		case OPCODE_MULTIPLY: run_multiply(vm); break;
 		case OPCODE_DIVIDE:   run_divide(vm); break;
@@ -342,6 +444,7 @@ static void run_vm(virtual_machine *vm) {
 
 		case OPCODE_INDEX:        run_index(vm); break;
 		case OPCODE_INDEX_ASSIGN: run_index_assign(vm); break;
+		case OPCODE_INDEX_ELEMENTS: run_index_elements(vm); break;
 		}
 	}
 }
@@ -6,10 +6,28 @@
 #include "value.h"
 #include "ast.h"
 #include "globals.h"
+#include "index_table.h"
+#include "cache.h"
+#include "reload.h"
+#include <setjmp.h>
+#include <ctype.h>
+#include <pthread.h>
+#include <stdatomic.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/stat.h>
 
-#define parse_error(...) die(__VA_ARGS__)
+// When recompiling functions for hot reloading (or compiling them ahead of time), errors are recovered
+// from instead of exiting. Functions can be compiled on several threads at once, so it's per-thread.
+static _Thread_local jmp_buf *speculative_compile;
+static _Thread_local char speculative_compile_error[256];
+
+#define parse_error(...) (speculative_compile != NULL \
+	? (snprintf(speculative_compile_error, sizeof(speculative_compile_error), __VA_ARGS__), \
+		longjmp(*speculative_compile, 1)) \
+	: die(__VA_ARGS__))
 
 // Since we discard all locals after returning, we can use the return local as scratch.
 #define SCRATCH_LOCAL CODEBLOCK_RETURN_LOCAL
@@ -25,22 +43,29 @@
 # define MAX_NUMBER_OF_BREAKS_PER_WHILE 64
 #endif
 
+// A local whose array literal never leaves the frame; its elements live in `element_locals`.
 typedef struct {
-	char *name;
-	unsigned local_index;
-} local_variable_entry;
+	symbol name;
+	unsigned length;
+	unsigned *element_locals; // `NULL` until the declaration is compiled.
+} scalar_replaced_array;
 
 typedef struct {
+	// Identifies this builder's entries within `local_slots`.
+	unsigned generation;
+
 	struct {
-		unsigned length, capacity;
-		local_variable_entry *entries;
-	} local_variables;
+		unsigned length;
+		scalar_replaced_array *entries;
+		index_table by_name;
+	} scalar_replaced_arrays;
 
 	unsigned number_of_locals;
 
 	struct {
 		unsigned length, capacity;
 		value *consts;
+		index_table by_value;
 	} constants;
 
 	struct {
@@ -65,46 +90,383 @@ static unsigned next_local_index(codeblock_builder *builder) {
 	return local_index;
 }
 
-static unsigned declare_local_variable(codeblock_builder *builder, char *name) {
+// Symbols are already unique, so they're used as their own hashes.
+static unsigned long long hash_name(symbol name) {
+	return name;
+}
+
+/*
+ * Locals are looked up by indexing `local_slots` with their name's symbol. Instead of clearing the
+ * slots for each codeblock (or after a compile error longjmps out of one), every builder gets a new
+ * generation, and slots left over from older generations are treated as empty.
+ */
+typedef struct {
+	unsigned generation;
+	unsigned local_index;
+} local_slot;
+
+static _Thread_local struct {
+	unsigned capacity, last_generation;
+	local_slot *slots;
+} local_slots;
+
+static local_slot *find_local_slot(symbol name) {
+	if (name >= local_slots.capacity) {
+		unsigned new_capacity = number_of_symbols();
+		assert(name < new_capacity);
+
+		if (new_capacity < local_slots.capacity * 2)
+			new_capacity = local_slots.capacity * 2;
+
+		local_slots.slots = xrealloc(local_slots.slots, new_capacity * sizeof(local_slot));
+		memset(&local_slots.slots[local_slots.capacity], 0, (new_capacity - local_slots.capacity) * sizeof(local_slot));
+		local_slots.capacity = new_capacity;
+	}
+
+	return &local_slots.slots[name];
+}
+
+static void free_local_slots(void) {
+	free(local_slots.slots);
+	local_slots.slots = NULL;
+	local_slots.capacity = 0;
+}
+
+static unsigned declare_local_variable(codeblock_builder *builder, symbol name) {
+	local_slot *slot = find_local_slot(name);
+
 	// Check to see if the variable's been used before
-	for (unsigned i = 0; i < builder->local_variables.length; i++) {
-		if (!strcmp(builder->local_variables.entries[i].name, name)) {
-			free(name);
-			// It has, return that index.
-			return builder->local_variables.entries[i].local_index;
+	if (slot->generation == builder->generation)
+		return slot->local_index;
+
+	// We haven't seen the variable before, let's add it.
+	slot->generation = builder->generation;
+	slot->local_index = next_local_index(builder);
+
+	LOG("locals[%d] = %s\n", slot->local_index, symbol_name(name));
+
+	return slot->local_index;
+}
+
+#define VARIABLE_DOESNT_EXIST (-1)
+
+static int lookup_local_variable(codeblock_builder *builder, symbol name) {
+	local_slot *slot = find_local_slot(name);
+
+	if (slot->generation != builder->generation)
+		return VARIABLE_DOESNT_EXIST;
+
+	return slot->local_index;
+}
+
+/*
+ * Escape analysis for array literals.
+ *
+ * A local declared exactly once as `hedgehog name = [...]`, and afterwards only ever used as the
+ * source of an index (`name[idx]`), never escapes the frame: nothing else can observe the array,
+ * so there's no need to allocate it at all. Instead, each element is kept in its own local and
+ * indexing selects between them with `OPCODE_INDEX_ELEMENTS`. The same is done for literals that
+ * are indexed immediately, such as `[1, 2][k]`.
+ *
+ * Any other use (reassignment, index assignment, passing it to a function, returning it, reading
+ * it before its declaration, etc) counts as escaping, in which case it's compiled normally. Only
+ * locals declared in the function's outermost block are replaced, as a declaration within an `if`
+ * or loop mightn't have run by the time a later use does.
+ */
+typedef struct {
+	symbol name;
+	unsigned length, number_of_declarations;
+	bool is_declared, escapes;
+} escape_candidate;
+
+typedef struct {
+	unsigned length, capacity;
+	escape_candidate *candidates;
+	index_table by_name;
+} escape_analysis;
+
+typedef struct {
+	const escape_candidate *candidates;
+	symbol name;
+} escape_candidate_query;
+
+static bool escape_candidate_matches(const void *context, unsigned index) {
+	const escape_candidate_query *query = context;
+	return query->candidates[index].name == query->name;
+}
+
+static escape_candidate *find_escape_candidate(escape_analysis *analysis, symbol name) {
+	escape_candidate_query query = { .candidates = analysis->candidates, .name = name };
+	unsigned index = lookup_index_table(&analysis->by_name, hash_name(name), escape_candidate_matches, &query);
+
+	return index == INDEX_TABLE_MISSING ? NULL : &analysis->candidates[index];
+}
+
+static void collect_candidates_in_block(escape_analysis *analysis, const ast_block *block, bool is_outermost);
+static void collect_candidates_in_statement(
+	escape_analysis *analysis,
+	const ast_statement *statement,
+	bool is_outermost
+) {
+	switch (statement->kind) {
+	case AST_STATEMENT_LOCAL: {
+		escape_candidate *candidate = find_escape_candidate(analysis, statement->local.name);
+
+		if (candidate == NULL) {
+			if (analysis->length == analysis->capacity) {
+				analysis->capacity = analysis->capacity == 0 ? 4 : analysis->capacity * 2;
+				analysis->candidates = xrealloc(
+					analysis->candidates,
+					analysis->capacity * sizeof(escape_candidate)
+				);
+			}
+
+			insert_index_table(&analysis->by_name, hash_name(statement->local.name), analysis->length);
+			candidate = &analysis->candidates[analysis->length++];
+			candidate->name = statement->local.name;
+			candidate->number_of_declarations = 0;
+			candidate->is_declared = false;
+			candidate->escapes = true;
 		}
+
+		candidate->number_of_declarations++;
+
+		const ast_expression *initializer = statement->local.initializer;
+		if (is_outermost && candidate->number_of_declarations == 1 && initializer != NULL
+			&& initializer->kind == AST_EXPRESSION_PRIMARY
+			&& initializer->primary->kind == AST_PRIMARY_ARRAY_LITERAL
+		) {
+			candidate->length = initializer->primary->array_literal.length;
+			candidate->escapes = false;
+		} else {
+			candidate->escapes = true;
+		}
+		break;
 	}
 
-	// We haven't seen the variable before, let's add it.
+	case AST_STATEMENT_IF:
+		collect_candidates_in_block(analysis, statement->if_.if_true, false);
+		if (statement->if_.if_false != NULL)
+			collect_candidates_in_block(analysis, statement->if_.if_false, false);
+		break;
 
-	if (builder->local_variables.length == builder->local_variables.capacity) {
-		builder->local_variables.capacity *= 2;
-		builder->local_variables.entries = xrealloc(
-			builder->local_variables.entries,
-			builder->local_variables.capacity * sizeof(local_variable_entry)
-		);
+	case AST_STATEMENT_WHILE:
+		collect_candidates_in_block(analysis, statement->while_.body, false);
+		break;
+
+	case AST_STATEMENT_FOR:
+		collect_candidates_in_statement(analysis, statement->for_.initializer, false);
+		collect_candidates_in_block(analysis, statement->for_.body, false);
+		break;
+
+	default:
+		break;
 	}
+}
 
-	unsigned local_index = next_local_index(builder);
+static void collect_candidates_in_block(escape_analysis *analysis, const ast_block *block, bool is_outermost) {
+	for (unsigned i = 0; i < block->number_of_statements; i++)
+		collect_candidates_in_statement(analysis, block->statements[i], is_outermost);
+}
 
-	builder->local_variables.entries[builder->local_variables.length].name = name;
-	builder->local_variables.entries[builder->local_variables.length].local_index = local_index;
+static void mark_escaping(escape_analysis *analysis, symbol name) {
+	escape_candidate *candidate = find_escape_candidate(analysis, name);
 
-	LOG("locals[%d] = %s\n", local_index, name);
+	if (candidate != NULL)
+		candidate->escapes = true;
+}
 
-	builder->local_variables.length++;
-	return local_index;
+static void find_escapes_in_expression(escape_analysis *analysis, const ast_expression *expression);
+static void find_escapes_in_primary(escape_analysis *analysis, const ast_primary *primary) {
+	switch (primary->kind) {
+	case AST_PRIMARY_PAREN:
+		find_escapes_in_expression(analysis, primary->paren.expression);
+		break;
+
+	case AST_PRIMARY_INDEX: {
+		const ast_primary *source = primary->index.source;
+
+		// Indexing a declared candidate doesn't let it escape; everything else is checked normally.
+		if (source->kind == AST_PRIMARY_VARIABLE) {
+			escape_candidate *candidate = find_escape_candidate(analysis, source->variable.name);
+
+			if (candidate == NULL || !candidate->is_declared)
+				mark_escaping(analysis, source->variable.name);
+		} else {
+			find_escapes_in_primary(analysis, source);
+		}
+
+		find_escapes_in_expression(analysis, primary->index.index);
+		break;
+	}
+
+	case AST_PRIMARY_FUNCTION_CALL:
+		find_escapes_in_primary(analysis, primary->function_call.function);
+		for (unsigned i = 0; i < primary->function_call.number_of_arguments; i++)
+			find_escapes_in_expression(analysis, primary->function_call.arguments[i]);
+		break;
+
+	case AST_PRIMARY_UNARY_OPERATOR:
+		find_escapes_in_primary(analysis, primary->unary_operator.primary);
+		break;
+
+	case AST_PRIMARY_ARRAY_LITERAL:
+		for (unsigned i = 0; i < primary->array_literal.length; i++)
+			find_escapes_in_expression(analysis, primary->array_literal.elements[i]);
+		break;
+
+	case AST_PRIMARY_VARIABLE:
+		mark_escaping(analysis, primary->variable.name);
+		break;
+
+	case AST_PRIMARY_LITERAL:
+		break;
+	}
 }
 
-#define VARIABLE_DOESNT_EXIST (-1)
+static void find_escapes_in_expression(escape_analysis *analysis, const ast_expression *expression) {
+	switch (expression->kind) {
+	case AST_EXPRESSION_ASSIGN:
+		mark_escaping(analysis, expression->assign.name);
+		find_escapes_in_expression(analysis, expression->assign.value);
+		break;
+
+	case AST_EXPRESSION_INDEX_ASSIGN:
+		find_escapes_in_primary(analysis, expression->index_assign.source);
+		find_escapes_in_expression(analysis, expression->index_assign.index);
+		find_escapes_in_expression(analysis, expression->index_assign.value);
+		break;
+
+	case AST_EXPRESSION_SHORT_CIRCUIT_OPERATOR:
+		find_escapes_in_primary(analysis, expression->short_circuit_operator.lhs);
+		find_escapes_in_expression(analysis, expression->short_circuit_operator.rhs);
+		break;
+
+	case AST_EXPRESSION_BINARY_OPERATOR:
+		find_escapes_in_primary(analysis, expression->binary_operator.lhs);
+		find_escapes_in_expression(analysis, expression->binary_operator.rhs);
+		break;
 
-static int lookup_local_variable(codeblock_builder *builder, const char *name) {
-	for (unsigned i = 0; i < builder->local_variables.length; i++) {
-		if (!strcmp(builder->local_variables.entries[i].name, name))
-			return builder->local_variables.entries[i].local_index;
+	case AST_EXPRESSION_PRIMARY:
+		find_escapes_in_primary(analysis, expression->primary);
+		break;
 	}
+}
+
+static void find_escapes_in_block(escape_analysis *analysis, const ast_block *block);
+static void find_escapes_in_statement(escape_analysis *analysis, const ast_statement *statement) {
+	switch (statement->kind) {
+	case AST_STATEMENT_LOCAL:
+		if (statement->local.initializer != NULL)
+			find_escapes_in_expression(analysis, statement->local.initializer);
 
-	return VARIABLE_DOESNT_EXIST;
+		// It's only usable after its declaration; any use before then refers to something else.
+		find_escape_candidate(analysis, statement->local.name)->is_declared = true;
+		break;
+
+	case AST_STATEMENT_RETURN:
+		if (statement->return_.expression != NULL)
+			find_escapes_in_expression(analysis, statement->return_.expression);
+		break;
+
+	case AST_STATEMENT_IF:
+		find_escapes_in_expression(analysis, statement->if_.condition);
+		find_escapes_in_block(analysis, statement->if_.if_true);
+		if (statement->if_.if_false != NULL)
+			find_escapes_in_block(analysis, statement->if_.if_false);
+		break;
+
+	case AST_STATEMENT_WHILE:
+		find_escapes_in_expression(analysis, statement->while_.condition);
+		find_escapes_in_block(analysis, statement->while_.body);
+		break;
+
+	case AST_STATEMENT_FOR:
+		find_escapes_in_statement(analysis, statement->for_.initializer);
+		find_escapes_in_expression(analysis, statement->for_.updator);
+		find_escapes_in_expression(analysis, statement->for_.condition);
+		find_escapes_in_block(analysis, statement->for_.body);
+		break;
+
+	case AST_STATEMENT_BREAK:
+	case AST_STATEMENT_CONTINUE:
+		break;
+
+	case AST_STATEMENT_EXPRESSION:
+		find_escapes_in_expression(analysis, statement->expression);
+		break;
+	}
+}
+
+static void find_escapes_in_block(escape_analysis *analysis, const ast_block *block) {
+	for (unsigned i = 0; i < block->number_of_statements; i++)
+		find_escapes_in_statement(analysis, block->statements[i]);
+}
+
+static void find_non_escaping_arrays(
+	codeblock_builder *builder,
+	const ast_block *body,
+	unsigned number_of_arguments,
+	const symbol *argument_names
+) {
+	escape_analysis analysis = { .length = 0, .capacity = 0, .candidates = NULL };
+	init_index_table(&analysis.by_name);
+
+	collect_candidates_in_block(&analysis, body, true);
+
+	// Arguments already hold a value when the function starts, so they can't be replaced.
+	for (unsigned i = 0; i < number_of_arguments; i++)
+		mark_escaping(&analysis, argument_names[i]);
+
+	find_escapes_in_block(&analysis, body);
+
+	builder->scalar_replaced_arrays.length = 0;
+	builder->scalar_replaced_arrays.entries = xmalloc(analysis.length * sizeof(scalar_replaced_array));
+	init_index_table(&builder->scalar_replaced_arrays.by_name);
+
+	for (unsigned i = 0; i < analysis.length; i++) {
+		if (analysis.candidates[i].escapes)
+			continue;
+
+		LOG("array local %s doesn't escape", symbol_name(analysis.candidates[i].name));
+
+		insert_index_table(
+			&builder->scalar_replaced_arrays.by_name,
+			hash_name(analysis.candidates[i].name),
+			builder->scalar_replaced_arrays.length
+		);
+
+		scalar_replaced_array *entry =
+			&builder->scalar_replaced_arrays.entries[builder->scalar_replaced_arrays.length++];
+		entry->name = analysis.candidates[i].name;
+		entry->length = analysis.candidates[i].length;
+		entry->element_locals = NULL;
+	}
+
+	free(analysis.candidates);
+	free_index_table(&analysis.by_name);
+}
+
+typedef struct {
+	const scalar_replaced_array *entries;
+	symbol name;
+} scalar_replaced_array_query;
+
+static bool scalar_replaced_array_matches(const void *context, unsigned index) {
+	const scalar_replaced_array_query *query = context;
+	return query->entries[index].name == query->name;
+}
+
+static scalar_replaced_array *lookup_scalar_replaced_array(codeblock_builder *builder, symbol name) {
+	scalar_replaced_array_query query = { .entries = builder->scalar_replaced_arrays.entries, .name = name };
+	unsigned index = lookup_index_table(
+		&builder->scalar_replaced_arrays.by_name,
+		hash_name(name),
+		scalar_replaced_array_matches,
+		&query
+	);
+
+	return index == INDEX_TABLE_MISSING ? NULL : &builder->scalar_replaced_arrays.entries[index];
 }
 
 static void set_bytecode(codeblock_builder *builder, bytecode bc) {
@@ -149,16 +511,33 @@ static void set_jump_dst(codeblock_builder *builder, unsigned jmp_src) {
 	builder->bytecode.code[jmp_src].count = builder->bytecode.length;
 }
 
+// Constants are only ever literals, ie strings, numbers, booleans, and null.
+static unsigned long long hash_constant(value constant) {
+	if (is_string(constant))
+		return hash_string(constant);
+
+	return hash_bytes((const char *) &constant, sizeof(value));
+}
+
+typedef struct {
+	const value *consts;
+	value constant;
+} constant_query;
+
+static bool constant_matches(const void *context, unsigned index) {
+	const constant_query *query = context;
+	return equate_values(query->consts[index], query->constant);
+}
+
 static void load_constant(codeblock_builder *builder, value constant, unsigned target_local) {
-	unsigned constant_index;
+	unsigned long long hash = hash_constant(constant);
+	constant_query query = { .consts = builder->constants.consts, .constant = constant };
+	unsigned constant_index = lookup_index_table(&builder->constants.by_value, hash, constant_matches, &query);
 
 	// If the constant already exists, then we don't need to store it again.
-	for (unsigned i = 0; i < builder->constants.length; i++) {
-		if (equate_values(builder->constants.consts[i], constant)) {
-			constant_index = i;
-			free_value(constant);
-			goto found_constant;
-		}
+	if (constant_index != INDEX_TABLE_MISSING) {
+		free_value(constant);
+		goto found_constant;
 	}
 
 	// We didn't find it, we need to allocate it.
@@ -172,6 +551,7 @@ static void load_constant(codeblock_builder *builder, value constant, unsigned t
 
 	constant_index = builder->constants.length;
 	builder->constants.consts[constant_index] = constant;
+	insert_index_table(&builder->constants.by_value, hash, constant_index);
 	builder->constants.length++;
 
 found_constant:
@@ -181,7 +561,89 @@ found_constant:
 	set_local(builder, target_local);
 }
 
+// Selects `element_locals[index_local]`, storing the result in `index_local` too.
+static void compile_index_elements(
+	codeblock_builder *builder,
+	unsigned length,
+	const unsigned *element_locals,
+	unsigned index_local
+) {
+	set_opcode(builder, OPCODE_INDEX_ELEMENTS);
+	set_count(builder, length);
+
+	for (unsigned i = 0; i < length; i++)
+		set_local(builder, element_locals[i]);
+
+	set_local(builder, index_local);
+	set_local(builder, index_local);
+}
+
 static void compile_expression(codeblock_builder *builder, ast_expression *expression, unsigned target_local);
+
+/*
+ * Calls to builtins (eg `gottagofast(x)`) are bound at compile time: instead of loading the global
+ * and dispatching on its kind, `OPCODE_CALL_BUILTIN` calls the builtin's function pointer directly,
+ * and `shoe_size` and `species` get their own opcodes. The argument count is checked here, so
+ * calls with the wrong amount are compiled normally so they fail at runtime like they used to.
+ *
+ * As globals can be reassigned, the opcodes also record the global they were bound to, and fall
+ * back to a normal call if it no longer holds the builtin.
+ *
+ * Returns whether the call was compiled.
+ */
+static bool compile_builtin_call(codeblock_builder *builder, ast_primary *primary, unsigned target_local) {
+	ast_primary *function = primary->function_call.function;
+
+	if (function->kind != AST_PRIMARY_VARIABLE)
+		return false;
+
+	if (lookup_local_variable(builder, function->variable.name) != VARIABLE_DOESNT_EXIST)
+		return false;
+
+	int global_index = lookup_global_variable(function->variable.name);
+	if (global_index == GLOBAL_DOESNT_EXIST || !is_builtin_function(peek_global_variable(global_index)))
+		return false;
+
+	builtin_function *builtin_func = as_builtin_function(peek_global_variable(global_index));
+	unsigned number_of_arguments = primary->function_call.number_of_arguments;
+
+	if (builtin_func->required_argument_count != number_of_arguments)
+		return false;
+
+	// It's one longer than it needs to be, as builtins such as `ringbox` take no arguments.
+	unsigned argument_locals[number_of_arguments + 1];
+	for (unsigned i = 0; i < number_of_arguments; i++) {
+		argument_locals[i] = next_local_index(builder);
+		compile_expression(builder, primary->function_call.arguments[i], argument_locals[i]);
+	}
+
+	builtin_function_index builtin_index = builtin_func - builtin_functions;
+
+	switch (builtin_index) {
+	case BUILTIN_LENGTH:
+		set_opcode(builder, OPCODE_LENGTH);
+		set_count(builder, global_index);
+		break;
+
+	case BUILTIN_TYPEOF:
+		set_opcode(builder, OPCODE_TYPEOF);
+		set_count(builder, global_index);
+		break;
+
+	default:
+		set_opcode(builder, OPCODE_CALL_BUILTIN);
+		set_count(builder, global_index);
+		set_count(builder, builtin_index);
+		set_count(builder, number_of_arguments);
+	}
+
+	for (unsigned i = 0; i < number_of_arguments; i++)
+		set_local(builder, argument_locals[i]);
+
+	set_local(builder, target_local);
+	return true;
+}
+
 static void compile_primary(codeblock_builder *builder, ast_primary *primary, unsigned target_local) {
 	switch (primary->kind) {
 	case AST_PRIMARY_PAREN:
@@ -189,6 +651,34 @@ static void compile_primary(codeblock_builder *builder, ast_primary *primary, un
 		break;
 
 	case AST_PRIMARY_INDEX: {
+		// Array literals that are only indexed are never allocated; see the escape analysis above.
+		if (primary->index.source->kind == AST_PRIMARY_ARRAY_LITERAL) {
+			ast_primary *literal = primary->index.source;
+			unsigned element_locals[literal->array_literal.length];
+
+			for (unsigned i = 0; i < literal->array_literal.length; i++) {
+				element_locals[i] = next_local_index(builder);
+				compile_expression(builder, literal->array_literal.elements[i], element_locals[i]);
+			}
+
+			compile_expression(builder, primary->index.index, target_local);
+			compile_index_elements(builder, literal->array_literal.length, element_locals, target_local);
+			break;
+		}
+
+		if (primary->index.source->kind == AST_PRIMARY_VARIABLE) {
+			scalar_replaced_array *replaced =
+				lookup_scalar_replaced_array(builder, primary->index.source->variable.name);
+
+			if (replaced != NULL) {
+				assert(replaced->element_locals != NULL);
+
+				compile_expression(builder, primary->index.index, target_local);
+				compile_index_elements(builder, replaced->length, replaced->element_locals, target_local);
+				break;
+			}
+		}
+
 		unsigned source_local = next_local_index(builder);
 		compile_primary(builder, primary->index.source, source_local);
 		compile_expression(builder, primary->index.index, target_local);
@@ -200,6 +690,9 @@ static void compile_primary(codeblock_builder *builder, ast_primary *primary, un
 	}
 
 	case AST_PRIMARY_FUNCTION_CALL: {
+		if (compile_builtin_call(builder, primary, target_local))
+			break;
+
 		unsigned function_local = next_local_index(builder);
 		compile_primary(builder, primary->function_call.function, function_local);
 
@@ -208,7 +701,6 @@ static void compile_primary(codeblock_builder *builder, ast_primary *primary, un
 			argument_locals[i] = next_local_index(builder);
 			compile_expression(builder, primary->function_call.arguments[i], argument_locals[i]);
 		}
-		free(primary->function_call.arguments);
 
 		set_opcode(builder, OPCODE_CALL);
 		set_local(builder, function_local);
@@ -243,7 +735,6 @@ static void compile_primary(codeblock_builder *builder, ast_primary *primary, un
 			element_locals[i] = next_local_index(builder);
 			compile_expression(builder, primary->array_literal.elements[i], element_locals[i]);
 		}
-		free(primary->array_literal.elements);
 
 		set_opcode(builder, OPCODE_ARRAY_LITERAL);
 		set_count(builder, primary->array_literal.length);
@@ -259,8 +750,6 @@ static void compile_primary(codeblock_builder *builder, ast_primary *primary, un
 		int local_index = lookup_local_variable(builder, primary->variable.name);
 
 		if (local_index != VARIABLE_DOESNT_EXIST) {
-			free(primary->variable.name);
-
 			set_opcode(builder, OPCODE_MOVE);
 			set_local(builder, local_index);
 			set_local(builder, target_local);
@@ -270,8 +759,7 @@ static void compile_primary(codeblock_builder *builder, ast_primary *primary, un
 		int global_index = lookup_global_variable(primary->variable.name);
 
 		if (global_index == GLOBAL_DOESNT_EXIST)
-			parse_error("undeclared variable '%s'", primary->variable.name);
-		free(primary->variable.name);
+			parse_error("undeclared variable '%s'", symbol_name(primary->variable.name));
 
 		set_opcode(builder, OPCODE_LOAD_GLOBAL_VARIABLE);
 		set_count(builder, global_index);
@@ -283,8 +771,6 @@ static void compile_primary(codeblock_builder *builder, ast_primary *primary, un
 		load_constant(builder, primary->literal.val, target_local);
 		break;
 	}
-
-	free(primary);
 }
 
 static opcode binary_operator_to_opcode(binary_operator operator) {
@@ -304,15 +790,112 @@ static opcode binary_operator_to_opcode(binary_operator operator) {
 	}
 }
 
+static bool does_expression_assign_to(const ast_expression *expression, symbol name);
+static bool does_primary_assign_to(const ast_primary *primary, symbol name) {
+	switch (primary->kind) {
+	case AST_PRIMARY_PAREN:
+		return does_expression_assign_to(primary->paren.expression, name);
+
+	case AST_PRIMARY_INDEX:
+		return does_primary_assign_to(primary->index.source, name)
+			|| does_expression_assign_to(primary->index.index, name);
+
+	case AST_PRIMARY_FUNCTION_CALL:
+		for (unsigned i = 0; i < primary->function_call.number_of_arguments; i++) {
+			if (does_expression_assign_to(primary->function_call.arguments[i], name))
+				return true;
+		}
+
+		return does_primary_assign_to(primary->function_call.function, name);
+
+	case AST_PRIMARY_UNARY_OPERATOR:
+		return does_primary_assign_to(primary->unary_operator.primary, name);
+
+	case AST_PRIMARY_ARRAY_LITERAL:
+		for (unsigned i = 0; i < primary->array_literal.length; i++) {
+			if (does_expression_assign_to(primary->array_literal.elements[i], name))
+				return true;
+		}
+
+		return false;
+
+	case AST_PRIMARY_VARIABLE:
+	case AST_PRIMARY_LITERAL:
+		return false;
+	}
+
+	bug("unknown primary kind %d", primary->kind);
+	return false;
+}
+
+static bool does_expression_assign_to(const ast_expression *expression, symbol name) {
+	switch (expression->kind) {
+	case AST_EXPRESSION_ASSIGN:
+		return expression->assign.name == name || does_expression_assign_to(expression->assign.value, name);
+
+	case AST_EXPRESSION_INDEX_ASSIGN:
+		return does_primary_assign_to(expression->index_assign.source, name)
+			|| does_expression_assign_to(expression->index_assign.index, name)
+			|| does_expression_assign_to(expression->index_assign.value, name);
+
+	case AST_EXPRESSION_SHORT_CIRCUIT_OPERATOR:
+		return does_primary_assign_to(expression->short_circuit_operator.lhs, name)
+			|| does_expression_assign_to(expression->short_circuit_operator.rhs, name);
+
+	case AST_EXPRESSION_BINARY_OPERATOR:
+		return does_primary_assign_to(expression->binary_operator.lhs, name)
+			|| does_expression_assign_to(expression->binary_operator.rhs, name);
+
+	case AST_EXPRESSION_PRIMARY:
+		return does_primary_assign_to(expression->primary, name);
+	}
+
+	bug("unknown expression kind %d", expression->kind);
+	return false;
+}
+
+static void emit_append(codeblock_builder *builder, unsigned local_index, unsigned target_local) {
+	set_opcode(builder, OPCODE_APPEND);
+	set_local(builder, local_index);
+	set_local(builder, target_local);
+	set_local(builder, target_local);
+}
+
+// Whether `assign` is `x = x + y`, which is compiled like `x += y` so that `x` can be appended to in
+// place. That's only the same if `y` doesn't assign to `x` itself.
+static bool is_self_append(const ast_expression *assign) {
+	const ast_expression *value = assign->assign.value;
+
+	return assign->assign.operator == BINARY_OP_UNDEF
+		&& value->kind == AST_EXPRESSION_BINARY_OPERATOR
+		&& value->binary_operator.operator == BINARY_OP_ADD
+		&& value->binary_operator.lhs->kind == AST_PRIMARY_VARIABLE
+		&& value->binary_operator.lhs->variable.name == assign->assign.name
+		&& !does_expression_assign_to(value->binary_operator.rhs, assign->assign.name);
+}
+
 static void compile_expression(codeblock_builder *builder, ast_expression *expression, unsigned target_local) {
 	switch (expression->kind) {
 	case AST_EXPRESSION_ASSIGN: {
+		int local_index = lookup_local_variable(builder, expression->assign.name);
+
+		// Adding onto a local uses `OPCODE_APPEND`, which takes the local's value instead of cloning it,
+		// so that it can be appended to in place.
+		if (local_index != VARIABLE_DOESNT_EXIST && expression->assign.operator == BINARY_OP_ADD) {
+			compile_expression(builder, expression->assign.value, target_local);
+			emit_append(builder, local_index, target_local);
+			break;
+		}
+
+		if (local_index != VARIABLE_DOESNT_EXIST && is_self_append(expression)) {
+			compile_expression(builder, expression->assign.value->binary_operator.rhs, target_local);
+			emit_append(builder, local_index, target_local);
+			break;
+		}
+
 		compile_expression(builder, expression->assign.value, target_local);
 
-		int local_index = lookup_local_variable(builder, expression->assign.name);
 		if (local_index != VARIABLE_DOESNT_EXIST) {
-			free(expression->assign.name);
-
 			if (expression->assign.operator != BINARY_OP_UNDEF) {
 				set_opcode(builder, binary_operator_to_opcode(expression->assign.operator));
 				set_local(builder, local_index);
@@ -328,11 +911,9 @@ static void compile_expression(codeblock_builder *builder, ast_expression *expre
 
 		int global_index = lookup_global_variable(expression->assign.name);
 		if (global_index == GLOBAL_DOESNT_EXIST) {
-			parse_error("unknown variable '%s'; declare it first.", expression->assign.name);
+			parse_error("unknown variable '%s'; declare it first.", symbol_name(expression->assign.name));
 		}
 
-		free(expression->assign.name);
-
 		if (expression->assign.operator != BINARY_OP_UNDEF) {
 			unsigned old_local_index = next_local_index(builder);
 			set_opcode(builder, OPCODE_LOAD_GLOBAL_VARIABLE);
@@ -345,6 +926,11 @@ static void compile_expression(codeblock_builder *builder, ast_expression *expre
 			set_local(builder, old_local_index);
 		}
 
+		// This is normally marked already by `resolve_function_body`, which also means globals aren't
+		// written to while functions are compiled in parallel.
+		if (!is_global_variable_reassigned(global_index))
+			mark_global_variable_reassigned(global_index);
+
 		set_opcode(builder, OPCODE_STORE_GLOBAL_VARIABLE);
 		set_local(builder, global_index);
 		set_local(builder, target_local);
@@ -417,14 +1003,26 @@ static void compile_expression(codeblock_builder *builder, ast_expression *expre
 		compile_primary(builder, expression->primary, target_local);
 		break;
 	}
-
-	free(expression);
 }
 
 static void compile_block(codeblock_builder *builder, ast_block *block);
 static void compile_statement(codeblock_builder *builder, ast_statement *statement) {
 	switch (statement->kind) {
 	case AST_STATEMENT_LOCAL: {
+		scalar_replaced_array *replaced = lookup_scalar_replaced_array(builder, statement->local.name);
+
+		if (replaced != NULL) {
+			ast_primary *literal = statement->local.initializer->primary;
+			assert(replaced->element_locals == NULL); // it's only declared once.
+
+			replaced->element_locals = xmalloc(replaced->length * sizeof(unsigned));
+			for (unsigned i = 0; i < replaced->length; i++) {
+				replaced->element_locals[i] = next_local_index(builder);
+				compile_expression(builder, literal->array_literal.elements[i], replaced->element_locals[i]);
+			}
+			break;
+		}
+
 		unsigned new_local = declare_local_variable(builder, statement->local.name);
 
 		if (statement->local.initializer == NULL) {
@@ -558,43 +1156,27 @@ static void compile_statement(codeblock_builder *builder, ast_statement *stateme
 		compile_expression(builder, statement->expression, SCRATCH_LOCAL);
 		break;
 	}
-
-	free(statement);
 }
 
 static void compile_block(codeblock_builder *builder, ast_block *block) {
 	for (unsigned i = 0; i < block->number_of_statements; i++)
 		compile_statement(builder, block->statements[i]);
-
-	free(block->statements);
-	free(block);
 }
 
-static function *build_function(
-	char *function_name,
-	unsigned number_of_arguments,
-	char **argument_names,
-	ast_block *body,
-	const char *source_filename,
-	unsigned source_line_number
-) {
+static codeblock *build_codeblock(unsigned number_of_arguments, const symbol *argument_names, ast_block *body) {
 	codeblock_builder builder;
 
-	builder.local_variables.length = 0;
-	builder.local_variables.capacity = 4;
-	builder.local_variables.entries = xmalloc(
-		builder.local_variables.capacity * sizeof(local_variable_entry)
-	);
-
+	builder.generation = ++local_slots.last_generation;
 	builder.number_of_locals = 1; // As we have an initial `CODEBLOCK_RETURN_LOCAL`.
 
 	// Arguments are simply the first few local variables
 	for (unsigned i = 0; i < number_of_arguments; i++)
-		(void) declare_local_variable(&builder, strdup(argument_names[i]));
+		(void) declare_local_variable(&builder, argument_names[i]);
 
 	builder.constants.length = 0;
 	builder.constants.capacity = 4;
 	builder.constants.consts = xmalloc(builder.constants.capacity * sizeof(value));
+	init_index_table(&builder.constants.by_value);
 
 	builder.bytecode.length = 0;
 	builder.bytecode.capacity = 8;
@@ -602,62 +1184,360 @@ static function *build_function(
 
 	builder.whiles.length = 0;
 
+	find_non_escaping_arrays(&builder, body, number_of_arguments, argument_names);
 	compile_block(&builder, body);
 
 	// all functions implicitly return `null` at the end.
 	load_constant(&builder, VALUE_NULL, CODEBLOCK_RETURN_LOCAL);
 	set_opcode(&builder, OPCODE_RETURN);
 
-	for (unsigned i = 0; i < builder.local_variables.length; i++)
-		free(builder.local_variables.entries[i].name);
-	free(builder.local_variables.entries);
+	free_index_table(&builder.constants.by_value);
 
-	codeblock *block = new_codeblock(
+	for (unsigned i = 0; i < builder.scalar_replaced_arrays.length; i++)
+		free(builder.scalar_replaced_arrays.entries[i].element_locals);
+	free(builder.scalar_replaced_arrays.entries);
+	free_index_table(&builder.scalar_replaced_arrays.by_name);
+
+	return new_codeblock(
 		builder.number_of_locals,
 		builder.bytecode.length,
 		builder.bytecode.code,
 		builder.constants.length,
 		builder.constants.consts
 	);
+}
 
-	return new_function(
-		function_name,
-		block,
-		number_of_arguments,
-		argument_names,
-		source_line_number,
-		source_filename
-	);
+/*
+ * Functions are only compiled when they're first called, but the names they use are resolved when
+ * they're declared, just as if they had been compiled right away: a variable that isn't a local must
+ * be a global that's already been declared (such as the function itself), and `break`s and
+ * `continue`s must be within loops. So, whether a program compiles never depends on which of its
+ * functions are called, or on whether it's being run, written to an image, or cached.
+ *
+ * Globals that are assigned to are marked as reassigned along the way, so that
+ * `fold_constant_globals` doesn't fold them.
+ */
+typedef struct {
+	// Identifies the function's locals within `local_slots`, the same as a builder's generation.
+	unsigned generation;
+
+	unsigned number_of_loops;
+	unsigned number_of_breaks[MAX_NUMBER_OF_NESTED_WHILES];
+} name_resolver;
+
+static bool is_resolved_local(name_resolver *resolver, symbol name) {
+	return find_local_slot(name)->generation == resolver->generation;
+}
+
+static void declare_resolved_local(name_resolver *resolver, symbol name) {
+	find_local_slot(name)->generation = resolver->generation;
+}
+
+static void resolve_expression(name_resolver *resolver, const ast_expression *expression);
+static void resolve_primary(name_resolver *resolver, const ast_primary *primary) {
+	switch (primary->kind) {
+	case AST_PRIMARY_PAREN:
+		resolve_expression(resolver, primary->paren.expression);
+		break;
+
+	case AST_PRIMARY_INDEX:
+		resolve_primary(resolver, primary->index.source);
+		resolve_expression(resolver, primary->index.index);
+		break;
+
+	case AST_PRIMARY_FUNCTION_CALL:
+		resolve_primary(resolver, primary->function_call.function);
+		for (unsigned i = 0; i < primary->function_call.number_of_arguments; i++)
+			resolve_expression(resolver, primary->function_call.arguments[i]);
+		break;
+
+	case AST_PRIMARY_UNARY_OPERATOR:
+		resolve_primary(resolver, primary->unary_operator.primary);
+		break;
+
+	case AST_PRIMARY_ARRAY_LITERAL:
+		for (unsigned i = 0; i < primary->array_literal.length; i++)
+			resolve_expression(resolver, primary->array_literal.elements[i]);
+		break;
+
+	case AST_PRIMARY_VARIABLE:
+		if (!is_resolved_local(resolver, primary->variable.name)
+			&& lookup_global_variable(primary->variable.name) == GLOBAL_DOESNT_EXIST
+		) {
+			parse_error("undeclared variable '%s'", symbol_name(primary->variable.name));
+		}
+		break;
+
+	case AST_PRIMARY_LITERAL:
+		break;
+	}
+}
+
+static void resolve_expression(name_resolver *resolver, const ast_expression *expression) {
+	switch (expression->kind) {
+	case AST_EXPRESSION_ASSIGN: {
+		resolve_expression(resolver, expression->assign.value);
+
+		if (is_resolved_local(resolver, expression->assign.name))
+			break;
+
+		int global_index = lookup_global_variable(expression->assign.name);
+		if (global_index == GLOBAL_DOESNT_EXIST)
+			parse_error("unknown variable '%s'; declare it first.", symbol_name(expression->assign.name));
+
+		mark_global_variable_reassigned(global_index);
+		break;
+	}
+
+	case AST_EXPRESSION_INDEX_ASSIGN:
+		resolve_primary(resolver, expression->index_assign.source);
+		resolve_expression(resolver, expression->index_assign.index);
+		resolve_expression(resolver, expression->index_assign.value);
+		break;
+
+	case AST_EXPRESSION_SHORT_CIRCUIT_OPERATOR:
+		resolve_primary(resolver, expression->short_circuit_operator.lhs);
+		resolve_expression(resolver, expression->short_circuit_operator.rhs);
+		break;
+
+	case AST_EXPRESSION_BINARY_OPERATOR:
+		resolve_primary(resolver, expression->binary_operator.lhs);
+		resolve_expression(resolver, expression->binary_operator.rhs);
+		break;
+
+	case AST_EXPRESSION_PRIMARY:
+		resolve_primary(resolver, expression->primary);
+		break;
+	}
+}
+
+static void resolve_block(name_resolver *resolver, const ast_block *block);
+
+static void resolve_loop_body(name_resolver *resolver, const ast_block *body, const char *kind) {
+	if (resolver->number_of_loops == MAX_NUMBER_OF_NESTED_WHILES)
+		parse_error("too many nested %ss encountered; only %d max allowed", kind, MAX_NUMBER_OF_NESTED_WHILES);
+
+	resolver->number_of_breaks[resolver->number_of_loops++] = 0;
+	resolve_block(resolver, body);
+	resolver->number_of_loops--;
+}
+
+// Statements are resolved in the order `compile_statement` compiles them, so locals are declared at
+// the same points.
+static void resolve_statement(name_resolver *resolver, const ast_statement *statement) {
+	switch (statement->kind) {
+	case AST_STATEMENT_LOCAL:
+		declare_resolved_local(resolver, statement->local.name);
+
+		if (statement->local.initializer != NULL)
+			resolve_expression(resolver, statement->local.initializer);
+		break;
+
+	case AST_STATEMENT_RETURN:
+		if (statement->return_.expression != NULL)
+			resolve_expression(resolver, statement->return_.expression);
+		break;
+
+	case AST_STATEMENT_IF:
+		resolve_expression(resolver, statement->if_.condition);
+		resolve_block(resolver, statement->if_.if_true);
+		if (statement->if_.if_false != NULL)
+			resolve_block(resolver, statement->if_.if_false);
+		break;
+
+	case AST_STATEMENT_WHILE:
+		resolve_expression(resolver, statement->while_.condition);
+		resolve_loop_body(resolver, statement->while_.body, "while");
+		break;
+
+	case AST_STATEMENT_FOR:
+		resolve_statement(resolver, statement->for_.initializer);
+		resolve_expression(resolver, statement->for_.updator);
+		resolve_expression(resolver, statement->for_.condition);
+		resolve_loop_body(resolver, statement->for_.body, "for");
+		break;
+
+	case AST_STATEMENT_BREAK:
+		if (resolver->number_of_loops == 0)
+			parse_error("cannot break when not within a while");
+
+		if (resolver->number_of_breaks[resolver->number_of_loops - 1]++ == MAX_NUMBER_OF_BREAKS_PER_WHILE) {
+			parse_error(
+				"too many breaks encountered; only %d max allowed per while",
+				MAX_NUMBER_OF_BREAKS_PER_WHILE
+			);
+		}
+		break;
+
+	case AST_STATEMENT_CONTINUE:
+		if (resolver->number_of_loops == 0)
+			parse_error("cannot continue when not within a while");
+		break;
+
+	case AST_STATEMENT_EXPRESSION:
+		resolve_expression(resolver, statement->expression);
+		break;
+	}
+}
+
+static void resolve_block(name_resolver *resolver, const ast_block *block) {
+	for (unsigned i = 0; i < block->number_of_statements; i++)
+		resolve_statement(resolver, block->statements[i]);
+}
+
+static void resolve_function_body(unsigned number_of_arguments, const symbol *argument_names, const ast_block *body) {
+	name_resolver resolver = { .generation = ++local_slots.last_generation, .number_of_loops = 0 };
+
+	for (unsigned i = 0; i < number_of_arguments; i++)
+		declare_resolved_local(&resolver, argument_names[i]);
+
+	resolve_block(&resolver, body);
+}
+
+// Whether every global's been declared, and so `fold_constant_globals` has been called.
+static bool are_globals_final;
+
+/*
+ * Every file that's been compiled, so that a file that's imported more than once (for example,
+ * two libraries that both import a third) is only compiled the first time. Files are identified by
+ * their device and inode, so different paths to the same file are recognized too.
+ */
+typedef struct {
+	dev_t device;
+	ino_t inode;
+	double seconds_to_compile;
+
+	// Owned by the registry, as the functions compiled from it refer to it for their whole lives.
+	char *filename;
+} compiled_module;
+
+static struct {
+	unsigned length, capacity;
+	compiled_module *modules;
+
+	// How many imports were skipped, and about how long compiling them again would've taken.
+	unsigned skipped_imports;
+	double seconds_saved;
+} module_registry;
+
+static double current_seconds(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static bool load_cached_file(const char *filename, unsigned long long source_hash, size_t source_length);
+static void add_pending_cache_file(
+	const char *filename,
+	const char *source_code,
+	unsigned long long source_hash,
+	size_t source_length
+);
+
+void compile_file(const char *filename) {
+	struct stat info;
+	if (stat(filename, &info) == -1)
+		die("unable to read file '%s': %s", filename, strerror(errno));
+
+	for (unsigned i = 0; i < module_registry.length; i++) {
+		compiled_module *module = &module_registry.modules[i];
+
+		if (module->device == info.st_dev && module->inode == info.st_ino) {
+			module_registry.skipped_imports++;
+			module_registry.seconds_saved += module->seconds_to_compile;
+
+			LOG("skipping already compiled file '%s' (saved %.3fms, %.3fms in total over %u imports)",
+				filename,
+				module->seconds_to_compile * 1000,
+				module_registry.seconds_saved * 1000,
+				module_registry.skipped_imports);
+			return;
+		}
+	}
+
+	if (module_registry.length == module_registry.capacity) {
+		module_registry.capacity = module_registry.capacity == 0 ? 8 : module_registry.capacity * 2;
+		module_registry.modules = xrealloc(
+			module_registry.modules,
+			module_registry.capacity * sizeof(compiled_module)
+		);
+	}
+
+	// Register it before compiling, so that files which (indirectly) import themselves terminate.
+	unsigned index = module_registry.length++;
+	module_registry.modules[index].device = info.st_dev;
+	module_registry.modules[index].inode = info.st_ino;
+	module_registry.modules[index].seconds_to_compile = 0;
+	module_registry.modules[index].filename = strdup(filename);
+	filename = module_registry.modules[index].filename;
+
+	double start = current_seconds();
+	size_t source_length;
+	const char *source_code = map_file(filename, &source_length);
+	unsigned long long source_hash = hash_bytes(source_code, source_length);
+
+	if (!load_cached_file(filename, source_hash, source_length)) {
+		compile(filename, source_code, source_length);
+		add_pending_cache_file(filename, source_code, source_hash, source_length);
+	}
+
+	if (is_hot_reload_enabled())
+		watch_file_for_reloads(filename, source_code, source_length);
+
+	module_registry.modules[index].seconds_to_compile = current_seconds() - start;
+}
+
+void report_import_stats(void) {
+	if (getenv("EMERALD_IMPORT_STATS") == NULL)
+		return;
+
+	fprintf(stderr, "compiled %u files, skipped %u repeated imports (saving about %.3fms)\n",
+		module_registry.length,
+		module_registry.skipped_imports,
+		module_registry.seconds_saved * 1000);
+}
+
+// Assigns `func` to `global`, which must've been declared before `func`'s body was looked at, so that
+// recursive functions can reference themselves.
+static void define_function(unsigned global, function *func) {
+	if (peek_global_variable(global) != VALUE_NULL)
+		parse_error("function %s redefined", func->function_name);
+
+	if (is_hot_reload_enabled())
+		mark_global_variable_reassigned(global);
+
+	assign_global_variable(global, new_function_value(func));
 }
 
 static void compile_declaration(ast_declaration *declaration) {
 	switch (declaration->kind) {
 	case AST_DECLARATION_FUNCTION: {
-		// declare it beforehand so recursive functions can reference the defn.
-		unsigned global = declare_global_variable(strdup(declaration->function.name));
+		unsigned global = declare_global_variable(declaration->function.name);
 
-		value function = new_function_value(build_function(
-			declaration->function.name,
+		// The body's only compiled when it's first called, but its names are resolved right away.
+		resolve_function_body(
 			declaration->function.number_of_arguments,
 			declaration->function.argument_names,
+			declaration->function.body
+		);
+
+		// The function takes over the declaration's arena, as its body's needed until it's compiled.
+		define_function(global, new_uncompiled_function(
+			symbol_name(declaration->function.name),
 			declaration->function.body,
-			declaration->source.filename,
-			declaration->source.line_number
+			declaration->arena,
+			declaration->function.number_of_arguments,
+			declaration->function.argument_names,
+			declaration->source.line_number,
+			declaration->source.filename
 		));
-
-		if (fetch_global_variable(global) != VALUE_NULL)
-			parse_error("function %s redefined", declaration->function.name);
-
-		assign_global_variable(global, function);
-		break;
+		return;
 	}
 
-	case AST_DECLARATION_IMPORT: {
-		// read the file contents
-		char *contents = read_file(declaration->import.path);
-		compile(declaration->import.path, contents);
+	case AST_DECLARATION_IMPORT:
+		compile_file(declaration->import.path);
+		free(declaration->import.path);
 		break;
-	}
 
 
 	case AST_DECLARATION_GLOBAL:
@@ -665,11 +1545,11 @@ static void compile_declaration(ast_declaration *declaration) {
 		break;
 	}
 
-	free(declaration);
+	free_arena(declaration->arena);
 }
 
-void compile(const char *filename, const char *source_code) {
-	tokenizer tzr = new_tokenizer(filename, source_code);
+void compile(const char *filename, const char *source_code, size_t source_length) {
+	tokenizer tzr = new_tokenizer(filename, source_code, source_length);
 
 	while (true) {
 		ast_declaration *declaration = next_declaration(&tzr);
@@ -684,3 +1564,408 @@ void compile(const char *filename, const char *source_code) {
 		compile_declaration(declaration);
 	}
 }
+
+static bool load_cached_file(const char *filename, unsigned long long source_hash, size_t source_length) {
+	cache_reader *reader = open_cache_file(source_hash, source_length);
+	if (reader == NULL)
+		return false;
+
+	cached_declaration declaration;
+	while (read_cached_declaration(reader, &declaration)) {
+		switch (declaration.kind) {
+		case CACHED_DECLARATION_FUNCTION: {
+			unsigned global = declare_global_variable(declaration.name);
+
+			// The same as `resolve_function_body`, except the body's already known to compile, so only
+			// its globals need to be checked. They refer to the globals by name, but must still have
+			// been declared already, as they would've been when the file was compiled from source.
+			cached_body *body = declaration.body;
+			for (unsigned i = 0; i < body->number_of_globals; i++) {
+				if (lookup_global_variable(body->global_names[i]) == GLOBAL_DOESNT_EXIST)
+					parse_error("undeclared variable '%s'", symbol_name(body->global_names[i]));
+			}
+
+			codeblock *block = body->block;
+			for (unsigned ip = 0; ip < block->code_length; ip += instruction_length(&block->code[ip])) {
+				if (block->code[ip].op == OPCODE_STORE_GLOBAL_VARIABLE)
+					mark_global_variable_reassigned(lookup_global_variable(body->global_names[block->code[ip + 1].count]));
+			}
+
+			function *func = new_uncompiled_function(
+				symbol_name(declaration.name),
+				NULL,
+				NULL,
+				declaration.number_of_arguments,
+				declaration.argument_names,
+				declaration.source_line_number,
+				filename
+			);
+
+			func->cached_body = declaration.body;
+			define_function(global, func);
+			break;
+		}
+
+		case CACHED_DECLARATION_IMPORT:
+			compile_file(declaration.path);
+			free(declaration.path);
+			break;
+
+		case CACHED_DECLARATION_GLOBAL:
+			declare_global_variable(declaration.name);
+			break;
+		}
+	}
+
+	close_cache_file(reader);
+	return true;
+}
+
+/*
+ * Files that were compiled from source while caching is enabled. They're only written to the cache
+ * once every file has been compiled, as the functions' bodies can refer to globals declared later on.
+ */
+static struct {
+	unsigned length, capacity;
+	struct pending_cache_file {
+		const char *filename, *source_code;
+		unsigned long long source_hash;
+		size_t source_length;
+	} *files;
+} pending_cache_files;
+
+static void add_pending_cache_file(
+	const char *filename,
+	const char *source_code,
+	unsigned long long source_hash,
+	size_t source_length
+) {
+	if (getenv("EMERALD_CACHE_DIR") == NULL)
+		return;
+
+	if (pending_cache_files.length == pending_cache_files.capacity) {
+		pending_cache_files.capacity = pending_cache_files.capacity == 0 ? 8 : pending_cache_files.capacity * 2;
+		pending_cache_files.files = xrealloc(
+			pending_cache_files.files,
+			pending_cache_files.capacity * sizeof(struct pending_cache_file)
+		);
+	}
+
+	pending_cache_files.files[pending_cache_files.length++] = (struct pending_cache_file) {
+		.filename = filename,
+		.source_code = source_code,
+		.source_hash = source_hash,
+		.source_length = source_length
+	};
+}
+
+static void write_cache_file(const struct pending_cache_file *file) {
+	cache_writer *writer = create_cache_file(file->source_hash, file->source_length);
+	if (writer == NULL)
+		return;
+
+	// The file's parsed again, as the original declarations' bodies are only compiled when called.
+	tokenizer tzr = new_tokenizer(file->filename, file->source_code, file->source_length);
+	ast_declaration *declaration;
+	jmp_buf on_error;
+
+	// Functions which don't compile can't be cached, but they're only an error if they're called.
+	// Their arena's freed, but any literals that weren't compiled yet are leaked.
+	if (setjmp(on_error)) {
+		speculative_compile = NULL;
+		free_arena(tzr.ast_arena);
+		LOG("not caching '%s', as it doesn't compile", file->filename);
+		discard_cache_file(writer);
+		return;
+	}
+
+	speculative_compile = &on_error;
+
+	while ((declaration = next_declaration(&tzr)) != NULL) {
+		switch (declaration->kind) {
+		case AST_DECLARATION_FUNCTION: {
+			unsigned number_of_arguments = declaration->function.number_of_arguments;
+			symbol *argument_names = declaration->function.argument_names;
+			codeblock *body = build_codeblock(number_of_arguments, argument_names, declaration->function.body);
+
+			write_cached_function(
+				writer,
+				declaration->function.name,
+				number_of_arguments,
+				argument_names,
+				declaration->source.line_number,
+				body
+			);
+
+			free_codeblock(body);
+			free(argument_names);
+			break;
+		}
+
+		case AST_DECLARATION_IMPORT:
+			write_cached_import(writer, declaration->import.path);
+			free(declaration->import.path);
+			break;
+
+		case AST_DECLARATION_GLOBAL:
+			write_cached_global(writer, declaration->global.name);
+			break;
+		}
+
+		free_arena(declaration->arena);
+	}
+
+	speculative_compile = NULL;
+	commit_cache_file(writer);
+}
+
+void write_pending_cache_files(void) {
+	for (unsigned i = 0; i < pending_cache_files.length; i++)
+		write_cache_file(&pending_cache_files.files[i]);
+
+	free(pending_cache_files.files);
+	pending_cache_files.length = pending_cache_files.capacity = 0;
+	pending_cache_files.files = NULL;
+}
+
+static unsigned add_folded_constant(codeblock *block, value constant) {
+	for (unsigned i = 0; i < block->number_of_constants; i++) {
+		if (block->constants[i] == constant)
+			return i;
+	}
+
+	block->constants = xrealloc(block->constants, (block->number_of_constants + 1) * sizeof(value));
+	block->constants[block->number_of_constants] = clone_value(constant);
+	return block->number_of_constants++;
+}
+
+static void fold_constant_globals_in(codeblock *block) {
+	for (unsigned ip = 0; ip < block->code_length; ip += instruction_length(&block->code[ip])) {
+		if (block->code[ip].op != OPCODE_LOAD_GLOBAL_VARIABLE)
+			continue;
+
+		unsigned global_index = block->code[ip + 1].count;
+		value global = peek_global_variable(global_index);
+
+		if (is_global_variable_reassigned(global_index) || !(is_function(global) || is_builtin_function(global)))
+			continue;
+
+		// `LOAD_GLOBAL_VARIABLE` and `LOAD_CONSTANT` have the same layout, so it can be done in place.
+		LOG("code[% 3d] = LOAD_GLOBAL_VARIABLE(%d) -> LOAD_CONSTANT", ip, global_index);
+		block->code[ip].op = OPCODE_LOAD_CONSTANT;
+		block->code[ip + 1].count = add_folded_constant(block, global);
+	}
+}
+
+void fold_constant_globals(void) {
+	are_globals_final = true;
+
+	// Functions are normally compiled after this, but fold any that have already been compiled.
+	for (unsigned i = 0; i < number_of_global_variables(); i++) {
+		value global = peek_global_variable(i);
+
+		if (is_function(global) && as_function(global)->body != NULL)
+			fold_constant_globals_in(as_function(global)->body);
+	}
+}
+
+// Frees `func`'s AST after `build_codeblock` has compiled it, which takes ownership of the literals.
+static void release_uncompiled_body(function *func) {
+	free_arena(func->uncompiled_body_arena);
+	func->uncompiled_body = NULL;
+	func->uncompiled_body_arena = NULL;
+}
+
+void compile_function_body(function *func) {
+	assert(func->body == NULL);
+
+	if (func->compile_error != NULL)
+		die("%s", func->compile_error);
+
+	if (func->cached_body != NULL) {
+		func->body = link_cached_body(func->cached_body);
+		func->cached_body = NULL;
+	} else {
+		func->body = build_codeblock(func->number_of_arguments, func->argument_names, func->uncompiled_body);
+		release_uncompiled_body(func);
+	}
+
+	if (are_globals_final)
+		fold_constant_globals_in(func->body);
+}
+
+bool recompile_declarations(const char *filename, unsigned number_of_declarations, const source_span *declarations) {
+	function **functions = xmalloc(number_of_declarations * sizeof(function *));
+	unsigned *globals = xmalloc(number_of_declarations * sizeof(unsigned));
+
+	// Modified between `setjmp` and `longjmp`, so they have to be `volatile`.
+	volatile unsigned number_of_functions = 0, number_compiled = 0;
+	volatile bool is_compiling = false;
+	jmp_buf on_error;
+
+	// Declaring things can fail too, such as when an import redefines a function, so that's also
+	// recovered from: whatever's been declared is kept, but none of the functions are replaced.
+	if (setjmp(on_error)) {
+		speculative_compile = NULL;
+		fprintf(stderr, "unable to reload %s: %s\n", filename, speculative_compile_error);
+
+		// As in `compile_queued_functions`, the literals of the one that failed are leaked.
+		if (is_compiling)
+			release_uncompiled_body(functions[number_compiled]);
+
+		for (unsigned i = 0; i < number_of_functions; i++)
+			free_function(functions[i]);
+
+		free(functions);
+		free(globals);
+		return false;
+	}
+
+	speculative_compile = &on_error;
+
+	for (unsigned i = 0; i < number_of_declarations; i++) {
+		tokenizer tzr = new_tokenizer(filename, declarations[i].source_code, declarations[i].length);
+		tzr.line_number = declarations[i].line_number;
+
+		ast_declaration *declaration = next_declaration(&tzr);
+		if (declaration->kind != AST_DECLARATION_FUNCTION) {
+			compile_declaration(declaration);
+			continue;
+		}
+
+		globals[number_of_functions] = declare_global_variable(declaration->function.name);
+		mark_global_variable_reassigned(globals[number_of_functions]);
+
+		functions[number_of_functions++] = new_uncompiled_function(
+			symbol_name(declaration->function.name),
+			declaration->function.body,
+			declaration->arena,
+			declaration->function.number_of_arguments,
+			declaration->function.argument_names,
+			declaration->source.line_number,
+			declaration->source.filename
+		);
+
+		// Resolved as each function's declared, as `compile_declaration` does.
+		resolve_function_body(
+			declaration->function.number_of_arguments,
+			declaration->function.argument_names,
+			declaration->function.body
+		);
+	}
+
+	is_compiling = true;
+	for (; number_compiled < number_of_functions; number_compiled++) {
+		function *func = functions[number_compiled];
+
+		func->body = build_codeblock(func->number_of_arguments, func->argument_names, func->uncompiled_body);
+		release_uncompiled_body(func);
+	}
+	speculative_compile = NULL;
+
+	// Calls that are running the old functions hold references to them, so they're kept alive until
+	// they return.
+	for (unsigned i = 0; i < number_of_functions; i++) {
+		fold_constant_globals_in(functions[i]->body);
+		assign_global_variable(globals[i], new_function_value(functions[i]));
+	}
+
+	LOG("recompiled %u functions in '%s'", number_of_functions, filename);
+	free(functions);
+	free(globals);
+	return true;
+}
+
+/*
+ * Functions that are compiled ahead of time by `compile_functions_in_parallel`. Each thread takes the
+ * next function from the queue until there are none left.
+ */
+static struct {
+	function **functions;
+	unsigned length;
+	atomic_uint next;
+} parallel_compile_queue;
+
+static void *compile_queued_functions(void *unused) {
+	(void) unused;
+
+	jmp_buf on_error;
+	unsigned index;
+
+	while ((index = atomic_fetch_add(&parallel_compile_queue.next, 1)) < parallel_compile_queue.length) {
+		function *func = parallel_compile_queue.functions[index];
+
+		// Any literals that weren't compiled yet are leaked, as there's no telling which ones they are.
+		if (setjmp(on_error)) {
+			func->compile_error = strdup(speculative_compile_error);
+			release_uncompiled_body(func);
+			continue;
+		}
+
+		speculative_compile = &on_error;
+		func->body = build_codeblock(func->number_of_arguments, func->argument_names, func->uncompiled_body);
+		release_uncompiled_body(func);
+	}
+
+	speculative_compile = NULL;
+	free_local_slots();
+	return NULL;
+}
+
+#define MAX_COMPILE_THREADS 64
+
+void compile_functions_in_parallel(void) {
+	const char *threads = getenv("EMERALD_COMPILE_THREADS");
+	if (threads == NULL)
+		return;
+
+	// `strtoul` would quietly accept a sign, leading whitespace or trailing garbage.
+	char *end;
+	unsigned long number_of_threads = strtoul(threads, &end, 10);
+	if (!isdigit((unsigned char) threads[0]) || *end != '\0')
+		die("EMERALD_COMPILE_THREADS must be a number of threads, not '%s'", threads);
+
+	assert(are_globals_final);
+
+	unsigned number_of_globals = number_of_global_variables();
+	parallel_compile_queue.functions = xmalloc(number_of_globals * sizeof(function *));
+	parallel_compile_queue.length = 0;
+	atomic_init(&parallel_compile_queue.next, 0);
+
+	for (unsigned i = 0; i < number_of_globals; i++) {
+		value global = peek_global_variable(i);
+
+		if (is_function(global) && as_function(global)->uncompiled_body != NULL)
+			parallel_compile_queue.functions[parallel_compile_queue.length++] = as_function(global);
+	}
+
+	// There's no point in having more threads than functions, and the current thread's one of them.
+	if (number_of_threads > parallel_compile_queue.length)
+		number_of_threads = parallel_compile_queue.length;
+	if (number_of_threads > MAX_COMPILE_THREADS)
+		number_of_threads = MAX_COMPILE_THREADS;
+	if (number_of_threads == 0)
+		number_of_threads = 1;
+
+	pthread_t workers[MAX_COMPILE_THREADS - 1];
+	for (unsigned i = 0; i < number_of_threads - 1; i++) {
+		if (pthread_create(&workers[i], NULL, compile_queued_functions, NULL) != 0)
+			die("unable to create compiler thread");
+	}
+
+	compile_queued_functions(NULL);
+
+	for (unsigned i = 0; i < number_of_threads - 1; i++)
+		pthread_join(workers[i], NULL);
+
+	// Folding clones the globals' values, which isn't thread safe, so it's done afterwards.
+	for (unsigned i = 0; i < parallel_compile_queue.length; i++) {
+		function *func = parallel_compile_queue.functions[i];
+
+		if (func->body != NULL)
+			fold_constant_globals_in(func->body);
+	}
+
+	LOG("compiled %u functions on %u threads", parallel_compile_queue.length, number_of_threads);
+	free(parallel_compile_queue.functions);
+}
@@ -1,3 +1,44 @@
 #pragma once
 
-void compile(const char *filename, const char *source_code);
+#include "function.h"
+
+void compile(const char *filename, const char *source_code, size_t source_length);
+
+// Reads and compiles `filename`, unless it's already been compiled (eg by an earlier `friend`).
+void compile_file(const char *filename);
+
+// If `EMERALD_IMPORT_STATS` is set, reports how many imports of already compiled files were skipped,
+// and about how long compiling them again would've taken, to stderr.
+void report_import_stats(void);
+
+// Writes every file compiled from source to the cache (see `cache.h`), if it's enabled. This must be
+// called after all files are compiled, but before `fold_constant_globals`.
+void write_pending_cache_files(void);
+
+// Compiles `func->uncompiled_body` (or links `func->cached_body`) into `func->body`. Functions are
+// compiled lazily, the first time they're called, so only the code that's actually used is ever compiled.
+// The names they use are resolved when they're declared, though, so the same programs are rejected.
+void compile_function_body(function *func);
+
+// Replaces loads of globals that hold functions and are never reassigned with constants. This must
+// be called after the entire program has been parsed, as only then is it known which globals are
+// reassigned; functions compiled afterwards are folded when they're compiled.
+void fold_constant_globals(void);
+
+// If `EMERALD_COMPILE_THREADS` is set, compiles every function that hasn't been yet, across that many
+// threads, but no more than there are functions or `MAX_COMPILE_THREADS`. This must be called after
+// `fold_constant_globals`, as globals mustn't change meanwhile.
+void compile_functions_in_parallel(void);
+
+// The source code of a single declaration within a file.
+typedef struct {
+	const char *source_code;
+	size_t length;
+	unsigned line_number; // Of the start of `source_code`.
+} source_span;
+
+// Compiles declarations from a file that's changed since it was compiled, for hot reloading (see
+// `reload.h`). Globals and imports are declared like usual, but functions' bodies are compiled right
+// away, and they replace the functions that were in their globals. If anything fails to compile, no
+// functions are replaced and false is returned, though parse errors and missing imports still exit.
+bool recompile_declarations(const char *filename, unsigned number_of_declarations, const source_span *declarations);
@@ -2,7 +2,9 @@
 
 #include <stdio.h>
 
+// Stdout is flushed first, so that the error comes after anything that was printed.
 #define die_with_stacktrace(...) (\
+	fflush(stdout), \
 	fprintf(stderr, __VA_ARGS__), \
 	fputs("\nstacktrace:\n", stderr), \
 	dump_stacktrace(stderr), \
@@ -1,13 +1,15 @@
 #include "function.h"
 #include "shared.h"
+#include "compile.h"
+#include "reload.h"
 #include <assert.h>
 #include <string.h>
 
 function *new_function(
-	char *function_name,
+	const char *function_name,
 	codeblock *body,
 	unsigned number_of_arguments,
-	char **argument_names,
+	symbol *argument_names,
 	unsigned source_line_number,
 	const char *source_filename
 ) {
@@ -17,6 +19,10 @@ function *new_function(
 
 	func->function_name = function_name;
 	func->body = body;
+	func->uncompiled_body = NULL;
+	func->uncompiled_body_arena = NULL;
+	func->cached_body = NULL;
+	func->compile_error = NULL;
 	func->refcount = 1;
 	func->number_of_arguments = number_of_arguments;
 	func->argument_names = argument_names;
@@ -26,20 +32,61 @@ function *new_function(
 	return func;
 }
 
+function *new_uncompiled_function(
+	const char *function_name,
+	ast_block *uncompiled_body,
+	arena *uncompiled_body_arena,
+	unsigned number_of_arguments,
+	symbol *argument_names,
+	unsigned source_line_number,
+	const char *source_filename
+) {
+	function *func = new_function(
+		function_name,
+		NULL,
+		number_of_arguments,
+		argument_names,
+		source_line_number,
+		source_filename
+	);
+
+	func->uncompiled_body = uncompiled_body;
+	func->uncompiled_body_arena = uncompiled_body_arena;
+	return func;
+}
+
 void deallocate_function(function *func) {
 	assert(func->refcount == 0);
 
-	free(func->function_name);
-	free_codeblock(func->body);
+	// Functions whose bodies were released by `release_function_bodies` have none of these.
+	if (func->body != NULL)
+		free_codeblock(func->body);
+	else if (func->cached_body != NULL)
+		free_cached_body(func->cached_body);
+	else if (func->uncompiled_body != NULL) {
+		free_ast_literals(func->uncompiled_body);
+		free_arena(func->uncompiled_body_arena);
+	}
+
+	free(func->compile_error);
 
-	for (unsigned i = 0; i < func->number_of_arguments; i++)
-		free(func->argument_names[i]);
 	free(func->argument_names);
 
 	free(func);
 }
 
-value call_function(const function *func, unsigned number_of_arguments, const value *arguments) {
+void release_function_bodies(function *func) {
+	if (func->body != NULL) {
+		free_codeblock(func->body);
+		func->body = NULL;
+	}
+}
+
+value call_function(function *func, unsigned number_of_arguments, const value *arguments) {
+	// Files that changed are only reloaded between calls, as nothing's being compiled then.
+	if (is_reload_pending)
+		reload_changed_files();
+
 	if (func->number_of_arguments != number_of_arguments) {
 		die_with_stacktrace(
 			"argument mismatch for %s: expected %d, got %d",
@@ -56,6 +103,10 @@ value call_function(const function *func, unsigned number_of_arguments, const va
 	};
 
 	enter_stackframe(&location);
+
+	if (func->body == NULL)
+		compile_function_body(func);
+
 	value ret = run_codeblock(func->body, number_of_arguments, arguments);
 	leave_stackframe();
 
@@ -69,7 +120,7 @@ void dump_function(FILE *out, const function *func) {
 		if (i != 0)
 			fputs(", ", out);
 
-		fputs(func->argument_names[i], out);
+		fputs(symbol_name(func->argument_names[i]), out);
 	}
 
 	fputs("])", out);
@@ -4,33 +4,58 @@
 #include "ast.h"
 #include "valuedefn.h"
 #include "codeblock.h"
+#include "cache.h"
 #include <stdalign.h>
 #include <stdio.h>
 
 typedef struct {
+	// `NULL` until the function is first called, at which point `uncompiled_body` is compiled (or
+	// `cached_body` is linked, for functions loaded from a cache file).
 	VALUE_ALIGNMENT codeblock *body;
+	ast_block *uncompiled_body;
+	arena *uncompiled_body_arena; // Holds `uncompiled_body`'s nodes.
+	cached_body *cached_body;
 
-	char *function_name;
+	// Set if compiling the body ahead of time failed, in which case it's reported when it's called.
+	char *compile_error;
+
+	// Interned, so it's never freed.
+	const char *function_name;
 	unsigned refcount;
 
 	unsigned number_of_arguments;
-	char **argument_names;
+	symbol *argument_names;
 
 	unsigned source_line_number;
 	const char *source_filename;
 } function;
 
 function *new_function(
-	char *function_name,
+	const char *function_name,
 	codeblock *body,
 	unsigned number_of_arguments,
-	char **argument_names,
+	symbol *argument_names,
+	unsigned source_line_number,
+	const char *source_filename
+);
+
+// Creates a function whose `body` is only compiled when it's first called.
+function *new_uncompiled_function(
+	const char *function_name,
+	ast_block *uncompiled_body,
+	arena *uncompiled_body_arena,
+	unsigned number_of_arguments,
+	symbol *argument_names,
 	unsigned source_line_number,
 	const char *source_filename
 );
 
 void deallocate_function(function *func);
 
+// Frees `func`'s compiled bodies. Globals that are folded into constants make recursive functions
+// refer to themselves, so this breaks those cycles before the globals are freed.
+void release_function_bodies(function *func);
+
 static inline void free_function(function *func) {
 	assert(func->refcount != 0);
 
@@ -44,5 +69,5 @@ static inline function *clone_function(function *func) {
 	return func;
 }
 
-value call_function(const function *func, unsigned number_of_arguments, const value *arguments);
+value call_function(function *func, unsigned number_of_arguments, const value *arguments);
 void dump_function(FILE *out, const function *func);
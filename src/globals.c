@@ -2,25 +2,36 @@
 #include "shared.h"
 #include "value.h"
 #include "builtin_function.h"
+#include <string.h>
 
 typedef struct {
-	char *name;
+	symbol name;
 	value val;
+	bool is_reassigned;
 } global_variable_entry;
 
+// Globals are referred to by their index in `entries` from within bytecode, so they're never moved
+// around; `by_symbol` maps each symbol to the index of the global with that name, if there is one.
 struct {
 	unsigned length, capacity;
 	global_variable_entry *entries;
+
+	unsigned number_of_symbols;
+	int *by_symbol;
 } globals;
 
 void init_global_variables(void) {
 	globals.length = 0;
 	globals.capacity = 8;
 	globals.entries = xmalloc(globals.capacity * sizeof(global_variable_entry));
+	globals.number_of_symbols = 0;
+	globals.by_symbol = NULL;
 
 	for (unsigned i = 0; i < NUMBER_OF_BUILTIN_FUNCTIONS; i++) {
+		const char *name = builtin_functions[i].name;
+
 		assign_global_variable(
-			declare_global_variable(strdup(builtin_functions[i].name)),
+			declare_global_variable(intern_symbol(name, strlen(name))),
 			new_builtin_function_value(&builtin_functions[i])
 		);
 	}
@@ -28,27 +39,69 @@ void init_global_variables(void) {
 
 void free_global_variables(void) {
 	for (unsigned i = 0; i < globals.length; i++) {
-		free(globals.entries[i].name);
-		free_value(globals.entries[i].val);
+		if (is_function(globals.entries[i].val))
+			release_function_bodies(as_function(globals.entries[i].val));
 	}
 
+	for (unsigned i = 0; i < globals.length; i++)
+		free_value(globals.entries[i].val);
+
 	free(globals.entries);
+	free(globals.by_symbol);
 }
 
-int lookup_global_variable(const char *name) {
-	for (unsigned i = 0; i < globals.length; i++) {
-		if (!strcmp(name, globals.entries[i].name))
-			return i;
-	}
+int lookup_global_variable(symbol name) {
+	// Symbols interned after `by_symbol` was last grown can't be globals yet.
+	if (name >= globals.number_of_symbols)
+		return GLOBAL_DOESNT_EXIST;
+
+	return globals.by_symbol[name];
+}
+
+int lookup_global_variable_by_name(const char *name) {
+	symbol sym = find_symbol(name, strlen(name));
+
+	return sym == SYMBOL_MISSING ? GLOBAL_DOESNT_EXIST : lookup_global_variable(sym);
+}
+
+unsigned number_of_global_variables(void) {
+	return globals.length;
+}
+
+const char *global_variable_name(unsigned index) {
+	return symbol_name(globals.entries[index].name);
+}
+
+void mark_global_variable_reassigned(unsigned index) {
+	assert(index < globals.length);
+
+	globals.entries[index].is_reassigned = true;
+}
+
+bool is_global_variable_reassigned(unsigned index) {
+	assert(index < globals.length);
 
-	return GLOBAL_DOESNT_EXIST;
+	return globals.entries[index].is_reassigned;
 }
 
-unsigned declare_global_variable(char *name) {
+unsigned declare_global_variable(symbol name) {
 	int previous_index = lookup_global_variable(name);
 	if (previous_index != GLOBAL_DOESNT_EXIST)
 		return previous_index;
 
+	if (name >= globals.number_of_symbols) {
+		// Grown geometrically, as declaring each new function's global usually needs a new symbol.
+		unsigned new_number_of_symbols = number_of_symbols();
+		if (new_number_of_symbols < globals.number_of_symbols * 2)
+			new_number_of_symbols = globals.number_of_symbols * 2;
+		globals.by_symbol = xrealloc(globals.by_symbol, new_number_of_symbols * sizeof(int));
+
+		for (unsigned i = globals.number_of_symbols; i < new_number_of_symbols; i++)
+			globals.by_symbol[i] = GLOBAL_DOESNT_EXIST;
+
+		globals.number_of_symbols = new_number_of_symbols;
+	}
+
 	if (globals.length == globals.capacity) {
 		globals.capacity *= 2;
 		globals.entries = xrealloc(globals.entries, globals.capacity * sizeof(global_variable_entry));
@@ -57,6 +110,8 @@ unsigned declare_global_variable(char *name) {
 	unsigned index = globals.length;
 	globals.entries[index].name = name;
 	globals.entries[index].val = VALUE_NULL;
+	globals.entries[index].is_reassigned = false;
+	globals.by_symbol[name] = index;
 	globals.length++;
 	return index;
 }
@@ -73,3 +128,9 @@ value fetch_global_variable(unsigned index) {
 
 	return clone_value(globals.entries[index].val);
 }
+
+value peek_global_variable(unsigned index) {
+	assert(index < globals.length);
+
+	return globals.entries[index].val;
+}
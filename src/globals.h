@@ -1,14 +1,28 @@
 #pragma once
+#include <stdbool.h>
 #include "valuedefn.h"
+#include "symbol.h"
 
 void init_global_variables(void);
 void free_global_variables(void);
 
 // the index of the global variable, creating it with a default of VALUE_NULL if it doesnt exist.
-unsigned declare_global_variable(char *name);
+unsigned declare_global_variable(symbol name);
 
 #define GLOBAL_DOESNT_EXIST (-1)
 
-int lookup_global_variable(const char *name);
+int lookup_global_variable(symbol name);
+int lookup_global_variable_by_name(const char *name);
+unsigned number_of_global_variables(void);
+const char *global_variable_name(unsigned index);
+
+// Globals are assumed to be constant unless compiled code assigns to them; the compiler calls
+// `mark_global_variable_reassigned` whenever it emits such an assignment.
+void mark_global_variable_reassigned(unsigned index);
+bool is_global_variable_reassigned(unsigned index);
 void assign_global_variable(unsigned index, value val);
 value fetch_global_variable(unsigned index);
+
+// Like `fetch_global_variable`, except the value isn't cloned; it's only valid until the next
+// assignment to `index`.
+value peek_global_variable(unsigned index);
@@ -0,0 +1,71 @@
+#include "index_table.h"
+#include "shared.h"
+#include <assert.h>
+
+#define INDEX_TABLE_INITIAL_CAPACITY 8
+
+void init_index_table(index_table *table) {
+	table->length = 0;
+	table->capacity = INDEX_TABLE_INITIAL_CAPACITY;
+	table->slots = xmalloc(table->capacity * sizeof(index_table_slot));
+
+	for (unsigned i = 0; i < table->capacity; i++)
+		table->slots[i].index = INDEX_TABLE_MISSING;
+}
+
+void free_index_table(index_table *table) {
+	free(table->slots);
+}
+
+unsigned lookup_index_table(
+	const index_table *table,
+	unsigned long long hash,
+	bool (*matches)(const void *context, unsigned index),
+	const void *context
+) {
+	// `capacity` is always a power of two, so we can mask instead of using `%`.
+	unsigned mask = table->capacity - 1;
+
+	for (unsigned i = hash & mask; table->slots[i].index != INDEX_TABLE_MISSING; i = (i + 1) & mask) {
+		if (table->slots[i].hash == hash && matches(context, table->slots[i].index))
+			return table->slots[i].index;
+	}
+
+	return INDEX_TABLE_MISSING;
+}
+
+static void insert_slot(index_table_slot *slots, unsigned capacity, unsigned long long hash, unsigned index) {
+	unsigned mask = capacity - 1;
+	unsigned i = hash & mask;
+
+	while (slots[i].index != INDEX_TABLE_MISSING)
+		i = (i + 1) & mask;
+
+	slots[i].hash = hash;
+	slots[i].index = index;
+}
+
+void insert_index_table(index_table *table, unsigned long long hash, unsigned index) {
+	assert(index != INDEX_TABLE_MISSING);
+
+	// Keep the load factor at or below one half so that probe sequences stay short.
+	if (table->capacity <= (table->length + 1) * 2) {
+		unsigned new_capacity = table->capacity * 2;
+		index_table_slot *new_slots = xmalloc(new_capacity * sizeof(index_table_slot));
+
+		for (unsigned i = 0; i < new_capacity; i++)
+			new_slots[i].index = INDEX_TABLE_MISSING;
+
+		for (unsigned i = 0; i < table->capacity; i++) {
+			if (table->slots[i].index != INDEX_TABLE_MISSING)
+				insert_slot(new_slots, new_capacity, table->slots[i].hash, table->slots[i].index);
+		}
+
+		free(table->slots);
+		table->slots = new_slots;
+		table->capacity = new_capacity;
+	}
+
+	insert_slot(table->slots, table->capacity, hash, index);
+	table->length++;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stdbool.h>
+
+/*
+ * An open-addressed hash table that maps hashes to indices into some other array, which is where
+ * the actual keys and values live. This lets tables that need stable indices (such as globals,
+ * locals, and constants) have O(1) lookups without changing their layout.
+ *
+ * As the table doesn't know about the keys, lookups take a `matches` callback which is called
+ * with `context` and the index of each entry whose hash is equal to the one being looked up.
+ */
+typedef struct {
+	unsigned long long hash;
+	unsigned index;
+} index_table_slot;
+
+typedef struct {
+	unsigned length, capacity;
+	index_table_slot *slots;
+} index_table;
+
+#define INDEX_TABLE_MISSING ((unsigned) -1)
+
+void init_index_table(index_table *table);
+void free_index_table(index_table *table);
+
+// Returns the index whose entry `matches`, or `INDEX_TABLE_MISSING` if there's none.
+unsigned lookup_index_table(
+	const index_table *table,
+	unsigned long long hash,
+	bool (*matches)(const void *context, unsigned index),
+	const void *context
+);
+
+// Adds `index` to `table`. It's up to the caller to make sure it isn't already in there.
+void insert_index_table(index_table *table, unsigned long long hash, unsigned index);
@@ -4,9 +4,11 @@
 #include "codeblock.h"
 #include "environment.h"
 #include "globals.h"
+#include "cache.h"
+#include <string.h>
 
 static void usage(const char *program_name) {
-	die("usage: %s (-e 'expression' | -f filename)", program_name);
+	die("usage: %s (-e 'expression' | -f filename | -i image | -o image filename)", program_name);
 }
 
 int main(int argc, char **argv) {
@@ -14,24 +16,48 @@ int main(int argc, char **argv) {
 	init_global_variables();
 	init_builtin_functions();
 
-	if (argc != 3 || argv[1][0] != '-' || argv[1][1] == '\0' || argv[1][2] != '\0')
+	if (argc < 3 || argv[1][0] != '-' || argv[1][1] == '\0' || argv[1][2] != '\0')
+		usage(argv[0]);
+
+	// `-o` writes an image of the compiled program, instead of running it.
+	if (argc != (argv[1][1] == 'o' ? 4 : 3))
 		usage(argv[0]);
 
 	switch (argv[1][1]) {
-	case 'e': compile("-e", argv[2]); break;
-	case 'f': compile(argv[2], read_file(argv[2])); break;
+	case 'e': compile("-e", argv[2], strlen(argv[2])); break;
+	case 'f': compile_file(argv[2]); break;
+	case 'o': compile_file(argv[3]); break;
+	case 'i': load_image(argv[2]); break;
 	default: usage(argv[0]);
 	}
 
-	int main_index = lookup_global_variable("main");
+	// Images are already compiled.
+	if (argv[1][1] != 'i') {
+		report_import_stats();
+		write_pending_cache_files();
+		fold_constant_globals();
+		compile_functions_in_parallel();
+	}
+
+	if (argv[1][1] == 'o') {
+		write_image(argv[2]);
+		return 0;
+	}
+
+	int main_index = lookup_global_variable_by_name("main");
 	if (main_index == GLOBAL_DOESNT_EXIST)
 		die("you must define a `main` function");
 
-	value ret = call_value(fetch_global_variable(main_index), 0, NULL);
+	value main_function = fetch_global_variable(main_index);
+	value ret = call_value(main_function, 0, NULL);
+	free_value(main_function);
 
 	free_environment();
 	free_global_variables();
 
+	// Leak checkers exit before stdio's flushed, which would lose everything that's still buffered.
+	fflush(stdout);
+
 	// If the return value of `main` is an integer, that's the return status.
 	if (is_number(ret))
 		return as_number(ret);
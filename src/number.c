@@ -1,29 +1,107 @@
 #include "number.h"
+#include "value.h"
 #include <ctype.h>
+#include <stdint.h>
 
-string *number_to_string(number num) {
-	// Assuming 64-bit `long long`, the largest string possible is `-9223372036854775807` (LLONG_MIN)
-	// That's 20 characters long. Including the ending `\0`, the buffer should be 21 bytes long. But,
-	// to be safe, let's just allocate 255.
-	char buf[255];
+// The two digits of every number below 100, so that formatting needs half as many divisions.
+static const char digit_pairs[200] =
+	"00010203040506070809" "10111213141516171819" "20212223242526272829" "30313233343536373839"
+	"40414243444546474849" "50515253545556575859" "60616263646566676869" "70717273747576777879"
+	"80818283848586878889" "90919293949596979899";
 
-	// We use `snprintf` just in case `long long`s aren't 64 bits for some reason
-	snprintf(buf, sizeof(buf), "%lld", num);
+static unsigned count_digits(unsigned long long magnitude) {
+	unsigned digits = 1;
 
-	return new_string(strdup(buf), strlen(buf));
+	for (; magnitude >= 10000; magnitude /= 10000)
+		digits += 4;
+
+	return digits + (magnitude >= 10) + (magnitude >= 100) + (magnitude >= 1000);
+}
+
+// Writes `num` into the `length` bytes at `buf`, where `length` is what `count_digits` counted plus
+// one for the `-` if it's negative. The digits are written from the end, two at a time.
+static void format_digits(char *buf, unsigned length, number num) {
+	unsigned long long magnitude = num < 0 ? -(unsigned long long) num : (unsigned long long) num;
+	char *end = buf + length;
+
+	for (; magnitude >= 100; magnitude /= 100) {
+		end -= 2;
+		memcpy(end, &digit_pairs[magnitude % 100 * 2], 2);
+	}
+
+	if (magnitude >= 10) {
+		end -= 2;
+		memcpy(end, &digit_pairs[magnitude * 2], 2);
+	} else {
+		*--end = '0' + magnitude;
+	}
+
+	if (num < 0)
+		buf[0] = '-';
 }
 
+static unsigned number_length(number num) {
+	unsigned long long magnitude = num < 0 ? -(unsigned long long) num : (unsigned long long) num;
+	return count_digits(magnitude) + (num < 0);
+}
+
+unsigned format_number(char *buf, number num) {
+	unsigned length = number_length(num);
+	format_digits(buf, length, num);
+	return length;
+}
+
+value number_to_string(number num) {
+	unsigned length = number_length(num);
+
+	if (length <= SMALL_STRING_CAPACITY) {
+		char buf[SMALL_STRING_CAPACITY];
+		format_digits(buf, length, num);
+		return new_small_string_value(buf, length);
+	}
+
+	// Otherwise, the digits are written straight into the string's buffer.
+	string *str = allocate_string(length);
+	format_digits(str->ptr, length, num);
+	str->length = length;
+
+	return new_string_value(str);
+}
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+// Parsing digits eight at a time relies upon the first digit being the lowest byte.
+#define PARSE_EIGHT_DIGITS_AT_ONCE
+
+static bool are_eight_digits(uint64_t chunk) {
+	// Each byte's high nibble must be 3, and adding 6 to its low nibble must keep it that way.
+	return ((chunk & 0xF0F0F0F0F0F0F0F0) | (((chunk + 0x0606060606060606) & 0xF0F0F0F0F0F0F0F0) >> 4))
+		== 0x3333333333333333;
+}
+
+// Combines neighbouring digits into pairs, then those into fours, then those into the result.
+static uint64_t parse_eight_digits(uint64_t chunk) {
+	chunk -= 0x3030303030303030;
+	chunk = (chunk * 10) + (chunk >> 8);
+	chunk = (((chunk & 0x000000FF000000FF) * 0x000F424000000064)
+		+ (((chunk >> 16) & 0x000000FF000000FF) * 0x0000271000000001)) >> 32;
+	return chunk;
+}
+#endif
+
 // We can't use `strtoll` as strings aren't null terminated.
-number string_to_number(const string *str) {
-	const char *ptr = str->ptr;
+number string_to_number(value str) {
+	string_contents contents;
+	get_string_contents(str, &contents);
+
+	const char *ptr = contents.ptr;
 	unsigned index = 0;
 
 	// Remove leading whitespace.
-	while (index < str->length && isspace(ptr[index]))
+	while (index < contents.length && isspace((unsigned char) ptr[index]))
 		index++;
 
 	// If there's nothing left, it's 0.
-	if (index == str->length)
+	if (index == contents.length)
 		return 0;
 
 	// Check for leading `-` or `+`s.
@@ -31,12 +109,27 @@ number string_to_number(const string *str) {
 	if (is_negative || ptr[index] == '+')
 		index++;
 
-	// Build the number.
-	number num = 0;
-	while (index < str->length && isdigit(ptr[index])) {
-		num = num * 10 + (ptr[index] - '0');
+	// Build the number. It's built unsigned, so that numbers which are too large wrap around
+	// instead of overflowing.
+	unsigned long long magnitude = 0;
+
+#ifdef PARSE_EIGHT_DIGITS_AT_ONCE
+	while (contents.length - index >= sizeof(uint64_t)) {
+		uint64_t chunk;
+		memcpy(&chunk, &ptr[index], sizeof(uint64_t));
+
+		if (!are_eight_digits(chunk))
+			break;
+
+		magnitude = magnitude * 100000000 + parse_eight_digits(chunk);
+		index += sizeof(uint64_t);
+	}
+#endif
+
+	while (index < contents.length && '0' <= ptr[index] && ptr[index] <= '9') {
+		magnitude = magnitude * 10 + (ptr[index] - '0');
 		index++;
 	}
 
-	return is_negative ? -num : num;
+	return is_negative ? -(number) magnitude : (number) magnitude;
 }
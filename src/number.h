@@ -9,5 +9,11 @@ static inline int compare_numbers(number lhs, number rhs) {
 	return lhs - rhs;
 }
 
-string *number_to_string(number num);
-number string_to_number(const string *str);
+// The most bytes `format_number` writes, which is the length of `LLONG_MIN`.
+#define MAX_NUMBER_LENGTH 20
+
+// Writes `num` in decimal to `buf`, returning how many bytes were written.
+unsigned format_number(char *buf, number num);
+
+value number_to_string(number num);
+number string_to_number(value str);
@@ -0,0 +1,498 @@
+#include "reload.h"
+#include "compile.h"
+#include "globals.h"
+#include "function.h"
+#include "index_table.h"
+#include "shared.h"
+#include "string.h"
+#include "token.h"
+#include "value.h"
+#include <errno.h>
+#include <pthread.h>
+#include <stdalign.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+atomic_bool is_reload_pending;
+
+// Whether hot reloading's enabled, or -1 if that hasn't been checked yet. Child processes that try
+// out reloads turn it off, so they don't touch the watcher (whose lock could've been held when they
+// were forked).
+static int is_enabled = -1;
+
+bool is_hot_reload_enabled(void) {
+	if (is_enabled == -1)
+		is_enabled = getenv("EMERALD_HOT_RELOAD") != NULL;
+
+	return is_enabled;
+}
+
+/*
+ * Files are compared declaration by declaration. Declarations are found by scanning the tokens,
+ * rather than by parsing them, since a declaration always starts with its keyword and those can't
+ * appear anywhere else. Each is hashed by its tokens, so that changes to whitespace and comments
+ * (or to the lines above it) don't make a function be recompiled.
+ */
+typedef struct {
+	token_kind kind; // `TOKEN_KIND_FUNCTION`, `TOKEN_KIND_GLOBAL`, or `TOKEN_KIND_IMPORT`.
+	symbol name; // `SYMBOL_MISSING` for imports.
+	char *import_path; // `NULL` for everything else.
+	unsigned long long hash;
+	unsigned line_number; // Of its keyword, unlike `span.line_number`.
+	source_span span;
+} scanned_declaration;
+
+typedef struct {
+	symbol name;
+	unsigned long long hash;
+} function_record;
+
+typedef struct {
+	unsigned length;
+	function_record *entries;
+	index_table by_name;
+} function_records;
+
+typedef struct {
+	// The path it was compiled as, which functions recompiled from it refer to, and its resolved path.
+	char *filename, *path;
+
+	// Its directory is what's watched, as editors often replace files rather than writing to them.
+	int watch;
+	const char *basename; // Points into `path`.
+	bool has_changed;
+
+	// The functions as of when it was last compiled.
+	function_records functions;
+} watched_file;
+
+static struct {
+	int inotify;
+
+	// The watching thread reads `files` (and sets their `has_changed`) while the program's running,
+	// so changing them requires `lock`. The rest of each file is only used by the main thread.
+	pthread_mutex_t lock;
+	unsigned length, capacity;
+	watched_file *files;
+} watcher = { .inotify = -1, .lock = PTHREAD_MUTEX_INITIALIZER };
+
+static unsigned long long mix_hash(unsigned long long hash, unsigned long long word) {
+	return (hash ^ word) * 0x100000001b3ULL;
+}
+
+static unsigned long long hash_token(unsigned long long hash, token tkn) {
+	hash = mix_hash(hash, tkn.kind);
+
+	if (tkn.kind == TOKEN_KIND_IDENTIFIER)
+		return mix_hash(hash, tkn.identifier);
+
+	if (tkn.kind != TOKEN_KIND_LITERAL)
+		return hash;
+
+	// Strings are allocated, so their contents are hashed instead; every other literal is immediate.
+	return mix_hash(hash, is_string(tkn.val) ? hash_string(tkn.val) : (unsigned long long) tkn.val);
+}
+
+// Returns the declarations in `source_code`, which must parse.
+static scanned_declaration *scan_declarations(
+	const char *filename,
+	const char *source_code,
+	size_t source_length,
+	unsigned *number_of_declarations
+) {
+	unsigned length = 0, capacity = 16;
+	scanned_declaration *declarations = xmalloc(capacity * sizeof(scanned_declaration));
+	tokenizer tzr = new_tokenizer(filename, source_code, source_length);
+
+	while (true) {
+		const char *start = tzr.stream;
+		unsigned start_line_number = tzr.line_number;
+		token tkn = next_token(&tzr);
+
+		if (tkn.kind == TOKEN_KIND_UNDEFINED)
+			break;
+
+		if (tkn.kind == TOKEN_KIND_FUNCTION || tkn.kind == TOKEN_KIND_GLOBAL || tkn.kind == TOKEN_KIND_IMPORT) {
+			if (length != 0)
+				declarations[length - 1].span.length = start - declarations[length - 1].span.source_code;
+
+			if (length == capacity) {
+				capacity *= 2;
+				declarations = xrealloc(declarations, capacity * sizeof(scanned_declaration));
+			}
+
+			declarations[length++] = (scanned_declaration) {
+				.kind = tkn.kind,
+				.name = SYMBOL_MISSING,
+				.import_path = NULL,
+				.hash = 0xcbf29ce484222325ULL,
+				.line_number = tzr.line_number,
+				.span = { .source_code = start, .line_number = start_line_number }
+			};
+		} else if (length == 0) {
+			bug("declaration in '%s' doesn't start with a keyword", filename);
+		}
+
+		scanned_declaration *declaration = &declarations[length - 1];
+		declaration->hash = hash_token(declaration->hash, tkn);
+
+		// The name (or path) always comes straight after the keyword.
+		if (declaration->kind == TOKEN_KIND_IMPORT && declaration->import_path == NULL && tkn.kind == TOKEN_KIND_LITERAL)
+			declaration->import_path = new_cstr_from_string(tkn.val);
+		else if (declaration->kind != TOKEN_KIND_IMPORT && declaration->name == SYMBOL_MISSING && tkn.kind == TOKEN_KIND_IDENTIFIER)
+			declaration->name = tkn.identifier;
+
+		if (tkn.kind == TOKEN_KIND_LITERAL)
+			free_value(tkn.val);
+	}
+
+	if (length != 0)
+		declarations[length - 1].span.length = tzr.stream - declarations[length - 1].span.source_code;
+
+	*number_of_declarations = length;
+	return declarations;
+}
+
+static void free_scanned_declarations(scanned_declaration *declarations, unsigned number_of_declarations) {
+	for (unsigned i = 0; i < number_of_declarations; i++)
+		free(declarations[i].import_path);
+
+	free(declarations);
+}
+
+typedef struct {
+	const function_record *entries;
+	symbol name;
+} function_record_query;
+
+static bool function_record_matches(const void *context, unsigned index) {
+	const function_record_query *query = context;
+	return query->entries[index].name == query->name;
+}
+
+static unsigned lookup_function_record(const function_records *records, symbol name) {
+	function_record_query query = { .entries = records->entries, .name = name };
+	return lookup_index_table(&records->by_name, name, function_record_matches, &query);
+}
+
+static void free_function_records(function_records *records) {
+	free(records->entries);
+	free_index_table(&records->by_name);
+}
+
+// Records the functions in `declarations`, returning false if any of them are declared twice.
+static bool record_functions(
+	const char *filename,
+	const scanned_declaration *declarations,
+	unsigned number_of_declarations,
+	function_records *records
+) {
+	records->length = 0;
+	records->entries = xmalloc((number_of_declarations + 1) * sizeof(function_record));
+	init_index_table(&records->by_name);
+
+	for (unsigned i = 0; i < number_of_declarations; i++) {
+		if (declarations[i].kind != TOKEN_KIND_FUNCTION)
+			continue;
+
+		if (lookup_function_record(records, declarations[i].name) != INDEX_TABLE_MISSING) {
+			fprintf(stderr, "not reloading '%s', as function %s is declared twice\n",
+				filename, symbol_name(declarations[i].name));
+
+			free_function_records(records);
+			return false;
+		}
+
+		insert_index_table(&records->by_name, declarations[i].name, records->length);
+		records->entries[records->length++] = (function_record) {
+			.name = declarations[i].name,
+			.hash = declarations[i].hash
+		};
+	}
+
+	return true;
+}
+
+static void *watch_for_changes(void *unused) {
+	(void) unused;
+
+	alignas(struct inotify_event) char events[4096];
+
+	while (true) {
+		ssize_t length = read(watcher.inotify, events, sizeof(events));
+
+		if (length == -1) {
+			if (errno == EINTR)
+				continue;
+
+			perror("unable to read changed files");
+			return NULL;
+		}
+
+		pthread_mutex_lock(&watcher.lock);
+
+		for (char *ptr = events; ptr < events + length; ) {
+			const struct inotify_event *event = (const struct inotify_event *) ptr;
+			ptr += sizeof(struct inotify_event) + event->len;
+
+			// Directories are watched, so most events are for files that aren't.
+			for (unsigned i = 0; i < watcher.length; i++) {
+				watched_file *file = &watcher.files[i];
+
+				if ((event->mask & IN_Q_OVERFLOW)
+					|| (event->wd == file->watch && event->len != 0 && strcmp(event->name, file->basename) == 0)
+				) {
+					file->has_changed = true;
+					is_reload_pending = true;
+				}
+			}
+		}
+
+		pthread_mutex_unlock(&watcher.lock);
+	}
+}
+
+static void start_watching(void) {
+	watcher.inotify = inotify_init1(IN_CLOEXEC);
+	if (watcher.inotify == -1)
+		die("unable to watch for reloads: %s", strerror(errno));
+
+	pthread_t thread;
+	if (pthread_create(&thread, NULL, watch_for_changes, NULL) != 0 || pthread_detach(thread) != 0)
+		die("unable to create reload thread");
+}
+
+static int find_watched_file(const char *path) {
+	for (unsigned i = 0; i < watcher.length; i++) {
+		if (strcmp(watcher.files[i].path, path) == 0)
+			return i;
+	}
+
+	return -1;
+}
+
+void watch_file_for_reloads(const char *filename, const char *source_code, size_t source_length) {
+	char *path = realpath(filename, NULL);
+	if (path == NULL)
+		die("unable to watch '%s' for reloads: %s", filename, strerror(errno));
+
+	if (watcher.inotify == -1)
+		start_watching();
+
+	char *basename = strrchr(path, '/');
+	*basename = '\0';
+	int watch = inotify_add_watch(watcher.inotify, *path == '\0' ? "/" : path, IN_CLOSE_WRITE | IN_MOVED_TO);
+	*basename++ = '/';
+
+	if (watch == -1)
+		die("unable to watch '%s' for reloads: %s", filename, strerror(errno));
+
+	unsigned number_of_declarations;
+	scanned_declaration *declarations = scan_declarations(filename, source_code, source_length, &number_of_declarations);
+	function_records functions;
+
+	// Files with duplicate functions don't compile, so it's fine for their records to be empty.
+	if (!record_functions(filename, declarations, number_of_declarations, &functions)) {
+		functions = (function_records) { .length = 0, .entries = NULL };
+		init_index_table(&functions.by_name);
+	}
+
+	free_scanned_declarations(declarations, number_of_declarations);
+	pthread_mutex_lock(&watcher.lock);
+
+	if (watcher.length == watcher.capacity) {
+		watcher.capacity = watcher.capacity == 0 ? 8 : watcher.capacity * 2;
+		watcher.files = xrealloc(watcher.files, watcher.capacity * sizeof(watched_file));
+	}
+
+	watcher.files[watcher.length++] = (watched_file) {
+		.filename = strdup(filename),
+		.path = path,
+		.watch = watch,
+		.basename = basename,
+		.has_changed = false,
+		.functions = functions
+	};
+
+	pthread_mutex_unlock(&watcher.lock);
+}
+
+// Parse errors and missing imports are fatal, so anything that could run into them is tried out in a
+// child process first. Returns whether `attempt` returned true there, rather than exiting.
+static bool succeeds_in_child(bool (*attempt)(const void *context), const void *context) {
+	// Otherwise anything that's buffered would be written by the child too, when it exits.
+	fflush(NULL);
+
+	pid_t child = fork();
+	if (child == -1) {
+		perror("unable to check changed file");
+		return false;
+	}
+
+	if (child == 0) {
+		is_enabled = false;
+		_exit(attempt(context) ? 0 : 1);
+	}
+
+	int status;
+	while (waitpid(child, &status, 0) == -1) {
+		if (errno != EINTR) {
+			perror("unable to check changed file");
+			return false;
+		}
+	}
+
+	return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+typedef struct {
+	const char *filename, *source_code;
+	size_t source_length;
+} parse_attempt;
+
+static bool attempt_parse(const void *context) {
+	const parse_attempt *attempt = context;
+	tokenizer tzr = new_tokenizer(attempt->filename, attempt->source_code, attempt->source_length);
+
+	while (next_declaration(&tzr) != NULL)
+		continue;
+
+	return true;
+}
+
+typedef struct {
+	const char *filename;
+	unsigned number_of_declarations;
+	const source_span *declarations;
+} recompile_attempt;
+
+// New imports are compiled as part of this, so they're checked as well.
+static bool attempt_recompile(const void *context) {
+	const recompile_attempt *attempt = context;
+	return recompile_declarations(attempt->filename, attempt->number_of_declarations, attempt->declarations);
+}
+
+static void reload_file(unsigned index) {
+	watched_file *file = &watcher.files[index];
+
+	// Editors can briefly remove files while saving them.
+	struct stat info;
+	if (stat(file->path, &info) == -1)
+		return;
+
+	// Nothing refers to the source once it's been compiled, as tokens' names and strings are copied.
+	size_t source_length;
+	const char *source_code = map_file(file->path, &source_length);
+	parse_attempt parse = { .filename = file->filename, .source_code = source_code, .source_length = source_length };
+
+	if (!succeeds_in_child(attempt_parse, &parse)) {
+		fprintf(stderr, "not reloading '%s', as it doesn't parse\n", file->filename);
+		unmap_file(source_code, source_length);
+		return;
+	}
+
+	unsigned number_of_declarations;
+	scanned_declaration *declarations = scan_declarations(file->filename, source_code, source_length, &number_of_declarations);
+	function_records functions;
+
+	if (!record_functions(file->filename, declarations, number_of_declarations, &functions)) {
+		free_scanned_declarations(declarations, number_of_declarations);
+		unmap_file(source_code, source_length);
+		return;
+	}
+
+	source_span *changed = xmalloc((number_of_declarations + 1) * sizeof(source_span));
+	unsigned number_changed = 0;
+
+	for (unsigned i = 0; i < number_of_declarations; i++) {
+		const scanned_declaration *declaration = &declarations[i];
+		bool has_changed;
+
+		switch (declaration->kind) {
+		case TOKEN_KIND_FUNCTION: {
+			unsigned record = lookup_function_record(&file->functions, declaration->name);
+			has_changed = record == INDEX_TABLE_MISSING || file->functions.entries[record].hash != declaration->hash;
+			break;
+		}
+
+		case TOKEN_KIND_GLOBAL:
+			has_changed = lookup_global_variable(declaration->name) == GLOBAL_DOESNT_EXIST;
+			break;
+
+		case TOKEN_KIND_IMPORT: {
+			// Files that are already watched have been compiled, even if it was through another path.
+			char *path = realpath(declaration->import_path, NULL);
+			has_changed = path == NULL || find_watched_file(path) == -1;
+			free(path);
+			break;
+		}
+
+		default:
+			bug("unknown declaration kind %d", declaration->kind);
+		}
+
+		if (has_changed)
+			changed[number_changed++] = declaration->span;
+	}
+
+	recompile_attempt recompile = {
+		.filename = file->filename,
+		.number_of_declarations = number_changed,
+		.declarations = changed
+	};
+
+	// The file's records are only replaced if it's reloaded, so that functions which failed to
+	// compile are tried again the next time it changes.
+	if (!succeeds_in_child(attempt_recompile, &recompile)) {
+		fprintf(stderr, "not reloading '%s', as it doesn't compile\n", file->filename);
+		free_function_records(&functions);
+	} else if (recompile_declarations(file->filename, number_changed, changed)) {
+		// Compiling imports may have watched more files, moving `watcher.files`.
+		file = &watcher.files[index];
+		free_function_records(&file->functions);
+		file->functions = functions;
+
+		// Functions that weren't recompiled may have still moved.
+		for (unsigned i = 0; i < number_of_declarations; i++) {
+			int global = declarations[i].kind == TOKEN_KIND_FUNCTION
+				? lookup_global_variable(declarations[i].name)
+				: GLOBAL_DOESNT_EXIST;
+
+			if (global != GLOBAL_DOESNT_EXIST && is_function(peek_global_variable(global)))
+				as_function(peek_global_variable(global))->source_line_number = declarations[i].line_number;
+		}
+
+		LOG("reloaded '%s', recompiling %u of its %u declarations", file->filename, number_changed, number_of_declarations);
+	} else {
+		free_function_records(&functions);
+	}
+
+	free(changed);
+	free_scanned_declarations(declarations, number_of_declarations);
+	unmap_file(source_code, source_length);
+}
+
+void reload_changed_files(void) {
+	// Cleared first, so that changes made while reloading aren't missed.
+	is_reload_pending = false;
+
+	// Reloading can watch more files, so `watcher.length` can change.
+	for (unsigned i = 0; ; i++) {
+		pthread_mutex_lock(&watcher.lock);
+
+		if (i == watcher.length) {
+			pthread_mutex_unlock(&watcher.lock);
+			break;
+		}
+
+		bool has_changed = watcher.files[i].has_changed;
+		watcher.files[i].has_changed = false;
+		pthread_mutex_unlock(&watcher.lock);
+
+		if (has_changed)
+			reload_file(i);
+	}
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * Hot reloading, which is enabled by setting `EMERALD_HOT_RELOAD`. Every file that's compiled is
+ * watched with inotify, and when one changes while the program's running, just the functions whose
+ * tokens changed are recompiled and swapped into their globals; everything else, including the
+ * values of globals, is left as it was. Calls that are already running finish with the old code.
+ *
+ * Changes are noticed by a thread that waits for inotify's events, but only acted on by
+ * `call_function`, so that functions are never replaced while something's being compiled. As any
+ * function's global can be replaced, loads of them aren't folded into constants when hot reloading
+ * is enabled.
+ */
+
+// Set by the watching thread when a watched file has changed.
+extern atomic_bool is_reload_pending;
+
+bool is_hot_reload_enabled(void);
+
+// Starts watching `filename`, whose contents have just been compiled, for changes.
+void watch_file_for_reloads(const char *filename, const char *source_code, size_t source_length);
+
+// Recompiles the changed functions in every watched file that's changed since it was last compiled.
+void reload_changed_files(void);
@@ -1,6 +1,8 @@
 #include "shared.h"
 #include <errno.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 void *xmalloc(size_t size) {
 	void *ptr = malloc(size);
@@ -26,12 +28,8 @@ void *xrealloc(void *ptr, size_t size) {
 	return ptr;
 }
 
-char *read_file(const char *filename) {
-	FILE *file = fopen(filename, "r");
-
-	if (file == NULL)
-		die("unable to read file '%s': %s", filename, strerror(errno));
-
+// Reads files that can't be mapped, such as pipes, into a buffer.
+static char *read_unmappable_file(const char *filename, FILE *file, size_t *length_out) {
 	size_t length = 0;
 	size_t capacity = 2048;
 	char *contents = xmalloc(capacity);
@@ -53,10 +51,68 @@ char *read_file(const char *filename) {
 		}
 	}
 
+	*length_out = length;
+	return contents;
+}
+
+const char *map_file(const char *filename, size_t *length) {
+	FILE *file = fopen(filename, "r");
+
+	if (file == NULL)
+		die("unable to read file '%s': %s", filename, strerror(errno));
+
+	struct stat info;
+	const char *contents;
+
+	if (fstat(fileno(file), &info) == -1)
+		die("unable to read file '%s': %s", filename, strerror(errno));
+
+	if (!S_ISREG(info.st_mode)) {
+		char *buffer = read_unmappable_file(filename, file, length);
+
+		// Copied into a mapping of its own, so that `unmap_file` works the same for every file.
+		if (*length == 0) {
+			contents = "";
+		} else {
+			void *copy = mmap(NULL, *length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+			if (copy == MAP_FAILED)
+				die("unable to map file '%s': %s", filename, strerror(errno));
+
+			contents = memcpy(copy, buffer, *length);
+		}
+
+		free(buffer);
+	} else if (info.st_size == 0) {
+		// Empty files can't be mapped.
+		contents = "";
+		*length = 0;
+	} else {
+		contents = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fileno(file), 0);
+		if (contents == MAP_FAILED)
+			die("unable to map file '%s': %s", filename, strerror(errno));
+
+		*length = info.st_size;
+	}
+
 	if (fclose(file) == EOF)
 		perror("couldn't close input file");
 
-	contents = xrealloc(contents, length + 1);
-	contents[length] = '\0';
 	return contents;
 }
+
+void unmap_file(const char *contents, size_t length) {
+	// Empty files aren't mapped.
+	if (length != 0 && munmap((void *) contents, length) == -1)
+		perror("unable to unmap file");
+}
+
+unsigned long long hash_bytes(const char *bytes, size_t length) {
+	unsigned long long hash = 0xcbf29ce484222325ULL;
+
+	for (size_t i = 0; i < length; i++) {
+		hash ^= (unsigned char) bytes[i];
+		hash *= 0x100000001b3ULL;
+	}
+
+	return hash;
+}
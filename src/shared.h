@@ -4,12 +4,20 @@
 
 #include "environment.h"
 
-#define die(...) (fprintf(stderr, __VA_ARGS__), fputs("\n", stderr), exit(1))
-#define bug(...) (fprintf(stderr, "%s:%d [bug] ", __FILE__, __LINE__), die(__VA_ARGS__))
+// Stdout is flushed first, like in `die_with_stacktrace`, so the error comes after anything printed.
+#define die(...) (fflush(stdout), fprintf(stderr, __VA_ARGS__), fputs("\n", stderr), exit(1))
+#define bug(...) (fflush(stdout), fprintf(stderr, "%s:%d [bug] ", __FILE__, __LINE__), die(__VA_ARGS__))
 
 void *xmalloc(size_t size);
 void *xrealloc(void *ptr, size_t size);
-char *read_file(const char *filename);
+
+// Maps the contents of `filename` into memory, setting `*length` to its size. The contents aren't
+// nul terminated, and stay mapped until they're given to `unmap_file` (if ever).
+const char *map_file(const char *filename, size_t *length);
+void unmap_file(const char *contents, size_t length);
+
+// A fast, non-cryptographic hash (FNV-1a) of `length` bytes starting at `bytes`.
+unsigned long long hash_bytes(const char *bytes, size_t length);
 
 #ifdef ENABLE_LOGGING
 # define LOG(...) (LOGN(__VA_ARGS__), puts(""))
@@ -1,5 +1,7 @@
 #include "string.h"
 #include "shared.h"
+#include "value.h"
+#include "index_table.h"
 #include <assert.h>
 #include <ctype.h>
 
@@ -8,7 +10,11 @@ string *new_string(char *ptr, unsigned length) {
 
 	str->refcount = 1;
 	str->length = length;
+	str->capacity = length;
 	str->ptr = ptr;
+	str->hash = 0;
+	str->is_interned = false;
+	str->parent = NULL;
 
 	return str;
 }
@@ -16,136 +22,339 @@ string *new_string(char *ptr, unsigned length) {
 void deallocate_string(string *str) {
 	assert(str->refcount == 0);
 
-	free(str->ptr);
+	if (str->parent != NULL)
+		free_string(str->parent);
+	else
+		free(str->ptr);
+
 	free(str);
 }
 
-string *index_string(const string *str, int idx) {
+value new_string_value_from_bytes(const char *ptr, unsigned length) {
+	if (length <= SMALL_STRING_CAPACITY)
+		return new_small_string_value(ptr, length);
+
+	string *str = allocate_string(length);
+	memcpy(str->ptr, ptr, length);
+	str->length = length;
+
+	return new_string_value(str);
+}
+
+value new_string_value_from_buffer(char *ptr, unsigned length) {
+	if (length > SMALL_STRING_CAPACITY)
+		return new_string_value(new_string(ptr, length));
+
+	value small = new_small_string_value(ptr, length);
+	free(ptr);
+	return small;
+}
+
+static struct {
+	unsigned length, capacity;
+	string **strings;
+	index_table by_contents;
+} interned_strings;
+
+typedef struct {
+	const char *ptr;
+	unsigned length;
+} interned_string_query;
+
+static bool interned_string_matches(const void *context, unsigned index) {
+	const interned_string_query *query = context;
+	const string *str = interned_strings.strings[index];
+
+	return str->length == query->length && !memcmp(str->ptr, query->ptr, query->length);
+}
+
+value intern_string_value(const char *ptr, unsigned length) {
+	if (length <= SMALL_STRING_CAPACITY)
+		return new_small_string_value(ptr, length);
+
+	if (interned_strings.capacity == 0)
+		init_index_table(&interned_strings.by_contents);
+
+	unsigned long long hash = hash_bytes(ptr, length);
+	interned_string_query query = { .ptr = ptr, .length = length };
+	unsigned index = lookup_index_table(&interned_strings.by_contents, hash, interned_string_matches, &query);
+
+	if (index != INDEX_TABLE_MISSING)
+		return new_string_value(interned_strings.strings[index]);
+
+	if (interned_strings.length == interned_strings.capacity) {
+		interned_strings.capacity = interned_strings.capacity == 0 ? 64 : interned_strings.capacity * 2;
+		interned_strings.strings = xrealloc(interned_strings.strings, interned_strings.capacity * sizeof(string *));
+	}
+
+	string *str = allocate_string(length);
+	memcpy(str->ptr, ptr, length);
+	str->length = length;
+	str->hash = hash;
+	str->is_interned = true;
+
+	index = interned_strings.length++;
+	interned_strings.strings[index] = str;
+	insert_index_table(&interned_strings.by_contents, hash, index);
+
+	return new_string_value(str);
+}
+
+value index_string(value str, int idx) {
+	string_contents contents;
+	get_string_contents(str, &contents);
+
 	if (idx < 0) {
-		idx += str->length;
+		idx += contents.length;
 
 		if (idx < 0)
-			return NULL;
+			return VALUE_UNDEFINED;
+	}
+
+	if (contents.length <= (unsigned) idx)
+		return VALUE_UNDEFINED;
+
+	return new_small_string_value(&contents.ptr[idx], 1);
+}
+
+value slice_string(value str, int start, unsigned length) {
+	unsigned str_length = string_length(str);
+
+	if (start < 0) {
+		start += str_length;
+
+		if (start < 0)
+			return VALUE_UNDEFINED;
+	}
+
+	if (str_length < (unsigned) start || str_length - start < length)
+		return VALUE_UNDEFINED;
+
+	if (length == str_length)
+		return clone_value(str);
+
+	if (length <= SMALL_STRING_CAPACITY) {
+		string_contents contents;
+		get_string_contents(str, &contents);
+		return new_small_string_value(contents.ptr + start, length);
 	}
 
-	if (str->length <= (unsigned) idx)
-		return NULL;
+	// Views always refer to the string that owns the buffer, so there's never a chain of them.
+	string *parent = as_string(str);
+	char *ptr = parent->ptr + start;
 
-	string *ret = allocate_string(1);
-	ret->ptr[0] = str->ptr[idx];
-	ret->length = 1;
+	if (parent->parent != NULL)
+		parent = parent->parent;
 
-	return ret;
+	string *view = new_string(ptr, length);
+	view->parent = clone_string(parent);
+
+	return new_string_value(view);
 }
 
-string *add_strings(string *lhs, string *rhs) {
-	if (lhs->length == 0)
-		return clone_string(rhs);
+value add_strings(value lhs, value rhs) {
+	unsigned lhs_length = string_length(lhs), rhs_length = string_length(rhs);
 
-	if (rhs->length == 0)
-		return clone_string(lhs);
+	if (lhs_length == 0)
+		return clone_value(rhs);
 
-	string *str = allocate_string(lhs->length + rhs->length);
-	memcpy(str->ptr, lhs->ptr, lhs->length);
-	memcpy(str->ptr + lhs->length, rhs->ptr, rhs->length);
-	str->length = lhs->length + rhs->length;
+	if (rhs_length == 0)
+		return clone_value(lhs);
 
-	return str;
+	unsigned length = lhs_length + rhs_length;
+
+	// Both sides must be small too, so the rhs's bytes just need to be shifted past the lhs's.
+	if (length <= SMALL_STRING_CAPACITY) {
+		value bytes = (lhs >> 8) | (rhs >> 8) << (8 * lhs_length);
+		return bytes << 8 | (value) length << 3 | VALUE_TAG_SMALL_STRING;
+	}
+
+	string_contents lhs_contents, rhs_contents;
+	get_string_contents(lhs, &lhs_contents);
+	get_string_contents(rhs, &rhs_contents);
+
+	string *str = allocate_string(length);
+	memcpy(str->ptr, lhs_contents.ptr, lhs_length);
+	memcpy(str->ptr + lhs_length, rhs_contents.ptr, rhs_length);
+	str->length = length;
+
+	return new_string_value(str);
 }
 
-int compare_strings(const string *lhs, const string *rhs) {
-	unsigned min_len = lhs->length < rhs->length ? lhs->length : rhs->length;
+int compare_strings(value lhs, value rhs) {
+	if (lhs == rhs)
+		return 0;
+
+	string_contents lhs_contents, rhs_contents;
+	get_string_contents(lhs, &lhs_contents);
+	get_string_contents(rhs, &rhs_contents);
+
+	unsigned min_len = lhs_contents.length < rhs_contents.length ? lhs_contents.length : rhs_contents.length;
 
 	// Compare the bytes of the strings to begin with. If they're not equal, then return that.
-	int cmp = memcmp(lhs->ptr, rhs->ptr, min_len);
+	int cmp = memcmp(lhs_contents.ptr, rhs_contents.ptr, min_len);
 	if (cmp != 0)
 		return cmp;
 
 	// Otherwise, the shorter string is smaller.
 	// If they have the same length and same `cmp`, they're equal
-	return lhs->length - rhs->length;
+	return lhs_contents.length - rhs_contents.length;
 }
 
-bool equate_strings(const string *lhs, const string *rhs) {
-	if (lhs->length != rhs->length)
+bool equate_strings(value lhs, value rhs) {
+	// Small strings have the same representation if they're equal, and are never equal to other strings.
+	if (is_small_string(lhs) || is_small_string(rhs))
+		return lhs == rhs;
+
+	const string *l = as_string(lhs), *r = as_string(rhs);
+
+	if (l == r)
+		return true;
+
+	if (l->is_interned && r->is_interned)
+		return false;
+
+	if (l->length != r->length)
+		return false;
+
+	// Hashes are only compared if they've both been computed already.
+	if (l->hash != 0 && r->hash != 0 && l->hash != r->hash)
 		return false;
 
-	return !memcmp(lhs->ptr, rhs->ptr, lhs->length);
+	return !memcmp(l->ptr, r->ptr, l->length);
+}
+
+void append_string(string *str, value rhs) {
+	assert(is_string_uniquely_owned(str));
+
+	string_contents contents;
+	get_string_contents(rhs, &contents);
+
+	if (str->capacity < str->length + contents.length) {
+		str->capacity *= 2;
+		if (str->capacity < str->length + contents.length)
+			str->capacity = str->length + contents.length;
+
+		str->ptr = xrealloc(str->ptr, str->capacity);
+	}
+
+	memcpy(str->ptr + str->length, contents.ptr, contents.length);
+	str->length += contents.length;
+	str->hash = 0;
+}
+
+unsigned long long hash_string(value str) {
+	if (!is_small_string(str)) {
+		string *s = as_string(str);
+
+		if (s->hash == 0)
+			s->hash = hash_bytes(s->ptr, s->length);
+
+		return s->hash;
+	}
+
+	string_contents contents;
+	get_string_contents(str, &contents);
+
+	return hash_bytes(contents.ptr, contents.length);
 }
 
-string *replicate_string(string *str, unsigned amnt) {
+value replicate_string(value str, unsigned amnt) {
 	if (amnt == 1)
-		return clone_string(str);
+		return clone_value(str);
 
-	string *ret = allocate_string(str->length * amnt);
+	string_contents contents;
+	get_string_contents(str, &contents);
 
-	for (unsigned i = 0; i < amnt; i++)
-		memcpy(ret->ptr + i*str->length, str->ptr, str->length);
+	unsigned length = contents.length * amnt;
+	char *ptr = xmalloc(length);
 
-	ret->length = str->length * amnt;
+	for (unsigned i = 0; i < amnt; i++)
+		memcpy(ptr + i*contents.length, contents.ptr, contents.length);
 
-	return ret;
+	return new_string_value_from_buffer(ptr, length);
 }
 
-char *new_cstr_from_string(const string *str) {
-	for (unsigned i = 0; i < str->length; i++) {
-		if (str->ptr[i] == '\0')
+char *new_cstr_from_string(value str) {
+	string_contents contents;
+	get_string_contents(str, &contents);
+
+	for (unsigned i = 0; i < contents.length; i++) {
+		if (contents.ptr[i] == '\0')
 			return NULL;
 	}
 
-	char *cstr = xmalloc(str->length + 1);
-	memcpy(cstr, str->ptr, str->length);
-	cstr[str->length] = '\0';
+	char *cstr = xmalloc(contents.length + 1);
+	memcpy(cstr, contents.ptr, contents.length);
+	cstr[contents.length] = '\0';
 	return cstr;
 }
 
-static void push_string(string *str, unsigned *capacity, char chr) {
-	if (*capacity <= str->length) {
-		*capacity *= 2;
-		str->ptr = xrealloc(str->ptr, *capacity);
-	}
+// Writes how `chr` appears within an inspected string to `buf`, returning how many bytes it took.
+static unsigned escape_char(char chr, char buf[4]) {
+	switch (chr) {
+	case '\n': chr = 'n'; goto slash;
+	case '\t': chr = 't'; goto slash;
+	case '\r': chr = 'r'; goto slash;
+	case '\0': chr = '0'; goto slash;
+	case '\f': chr = 'f'; goto slash;
+	case '\\':
+	case '\"':
+	case '\'':
+	slash:
+		buf[0] = '\\';
+		buf[1] = chr;
+		return 2;
+
+	default:
+		if (isprint(chr)) {
+			buf[0] = chr;
+			return 1;
+		}
 
-	str->ptr[str->length] = chr;
-	str->length++;
+		buf[0] = '\\';
+		buf[1] = 'x';
+		buf[2] = '0' + (chr >> 4);
+		buf[3] = '0' + (chr & 0xf);
+		return 4;
+	}
 }
 
-string *inspect_string(const string *str) {
-	string *inspected = allocate_string(str->length + 2); // the 2 is for the quotes
-	unsigned capacity = str->length + 2;
+value inspect_string(value str) {
+	string_contents contents;
+	get_string_contents(str, &contents);
 
-	push_string(inspected, &capacity, '"');
+	string_builder builder;
+	init_string_builder(&builder, contents.length + 2); // the 2 is for the quotes
+	append_bytes_to_string_builder(&builder, "\"", 1);
 
-	for (unsigned i = 0; i < str->length; ++i) {
-		char chr = str->ptr[i];
+	for (unsigned i = 0; i < contents.length; ++i) {
+		char buf[4];
+		append_bytes_to_string_builder(&builder, buf, escape_char(contents.ptr[i], buf));
+	}
+
+	append_bytes_to_string_builder(&builder, "\"", 1);
+	return finish_string_builder(&builder);
+}
 
-		switch (chr) {
-		case '\n': chr = 'n'; goto slash;
-		case '\t': chr = 't'; goto slash;
-		case '\r': chr = 'r'; goto slash;
-		case '\0': chr = '0'; goto slash;
-		case '\f': chr = 'f'; goto slash;
-		case '\\':
-		case '\"':
-		case '\'':
-		slash:
-			push_string(inspected, &capacity, '\\');
-			break;
+void print_inspected_string(FILE *out, value str) {
+	string_contents contents;
+	get_string_contents(str, &contents);
 
-		default:
-			if (isprint(chr))
-				break;
+	putc('"', out);
 
-			push_string(inspected, &capacity, '\\');
-			push_string(inspected, &capacity, 'x');
-			push_string(inspected, &capacity, '0' + (chr >> 4));
-			push_string(inspected, &capacity, '0' + (chr & 0xf));
+	for (unsigned i = 0; i < contents.length; ++i) {
+		char chr = contents.ptr[i];
+
+		// Most characters don't need escaping, so they skip `escape_char`'s buffer.
+		if (isprint(chr) && chr != '\\' && chr != '"' && chr != '\'') {
+			putc(chr, out);
 			continue;
 		}
 
-		push_string(inspected, &capacity, chr);
+		char buf[4];
+		fwrite(buf, 1, escape_char(chr, buf), out);
 	}
 
-	push_string(inspected, &capacity, '"');
-
-	return inspected;
+	putc('"', out);
 }
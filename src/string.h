@@ -8,20 +8,37 @@
 
 // Note that strings are not nul terminated, and as such aren't compatible with any of the
 // builtin `strxxx` family of functions (eg `strdup`).
-typedef struct {
+typedef struct string {
 	VALUE_ALIGNMENT char *ptr;
-	unsigned refcount, length;
+	unsigned refcount, length, capacity;
+
+	// Interned strings are never freed, and are the only interned string with their bytes, so two of
+	// them are equal only if they're the same string. Their refcounts aren't used, which also makes
+	// it safe to share them between threads.
+	bool is_interned;
+
+	// Cached by `hash_string`, and zero until it's first needed.
+	unsigned long long hash;
+
+	// Views (see `slice_string`) point into their parent's buffer instead of owning one, and hold a
+	// reference to their parent. This is `NULL` for every other string.
+	struct string *parent;
 } string;
 
 string *new_string(char *ptr, unsigned length);
 
 static inline string *allocate_string(unsigned capacity) {
-	return new_string(xmalloc(capacity), 0);
+	string *str = new_string(xmalloc(capacity), 0);
+	str->capacity = capacity;
+	return str;
 }
 
 void deallocate_string(string *str);
 
 static inline void free_string(string *str) {
+	if (str->is_interned)
+		return;
+
 	assert(str->refcount != 0);
 
 	str->refcount--;
@@ -29,18 +46,50 @@ static inline void free_string(string *str) {
 		deallocate_string(str);
 }
 
+// Whether `str` can be changed in place, because nothing else refers to it.
+static inline bool is_string_uniquely_owned(const string *str) {
+	return str->refcount == 1 && !str->is_interned && str->parent == NULL;
+}
+
 static inline string *clone_string(string *str) {
-	str->refcount++;
+	if (!str->is_interned)
+		str->refcount++;
+
 	return str;
 }
 
-string *index_string(const string *str, int idx);
-string *add_strings(string *lhs, string *rhs);
-int compare_strings(const string *lhs, const string *rhs);
-bool equate_strings(const string *lhs, const string *rhs);
-string *replicate_string(string *str, unsigned amnt);
+// Creates a string out of a copy of the `length` bytes starting at `ptr`.
+value new_string_value_from_bytes(const char *ptr, unsigned length);
+
+// Creates a string out of `ptr`, taking ownership of it like `new_string` does. It's freed straight
+// away if the string's small.
+value new_string_value_from_buffer(char *ptr, unsigned length);
+
+// Returns the interned string with the `length` bytes starting at `ptr`, interning a copy of them if
+// they're new. This is used for literals and for the strings that builtins return, such as `species`'s.
+value intern_string_value(const char *ptr, unsigned length);
+
+// These all take strings of either kind (see `value.h`), and return new strings.
+value index_string(value str, int idx); // returns `VALUE_UNDEFINED` if `idx` is out of bounds.
+value add_strings(value lhs, value rhs);
+int compare_strings(value lhs, value rhs);
+bool equate_strings(value lhs, value rhs);
+value replicate_string(value str, unsigned amnt);
+
+// Returns the `length` bytes starting at `start`, which counts from the end if it's negative, or
+// `VALUE_UNDEFINED` if they're out of bounds. Unless it's small, the result is a view into `str`'s
+// buffer rather than a copy.
+value slice_string(value str, int start, unsigned length);
+unsigned long long hash_string(value str);
+
+// Appends `rhs` onto `str`, which must be uniquely owned. Its capacity is at least doubled when it
+// runs out, so appending to it repeatedly takes amortized linear time.
+void append_string(string *str, value rhs);
 
 // returns `NULL` if `str` contains a null byte.
-char *new_cstr_from_string(const string *str);
+char *new_cstr_from_string(value str);
+
+value inspect_string(value str);
 
-string *inspect_string(const string *str);
+// Writes what `inspect_string` would return to `out`, without building it up first.
+void print_inspected_string(FILE *out, value str);
@@ -0,0 +1,82 @@
+#include "string_builder.h"
+#include "value.h"
+
+void init_string_builder(string_builder *builder, unsigned capacity) {
+	builder->ptr = xmalloc(capacity);
+	builder->refcount = 1;
+	builder->length = 0;
+	builder->capacity = capacity;
+}
+
+string_builder *new_string_builder(unsigned capacity) {
+	string_builder *builder = xmalloc(sizeof(string_builder));
+	init_string_builder(builder, capacity);
+	return builder;
+}
+
+void deallocate_string_builder(string_builder *builder) {
+	assert(builder->refcount == 0);
+
+	free(builder->ptr);
+	free(builder);
+}
+
+void reserve_string_builder(string_builder *builder, unsigned additional) {
+	unsigned required = builder->length + additional;
+
+	if (required <= builder->capacity)
+		return;
+
+	// Double it, so that appending one thing at a time takes amortized linear time.
+	builder->capacity = builder->capacity * 2 < required ? required : builder->capacity * 2;
+	builder->ptr = xrealloc(builder->ptr, builder->capacity);
+}
+
+void append_bytes_to_string_builder(string_builder *builder, const char *ptr, unsigned length) {
+	// A finished builder has no buffer at all, which can't be passed to `memcpy`.
+	if (length == 0)
+		return;
+
+	reserve_string_builder(builder, length);
+
+	memcpy(builder->ptr + builder->length, ptr, length);
+	builder->length += length;
+}
+
+void append_value_to_string_builder(string_builder *builder, value val) {
+	if (is_string(val)) {
+		string_contents contents;
+		get_string_contents(val, &contents);
+		append_bytes_to_string_builder(builder, contents.ptr, contents.length);
+		return;
+	}
+
+	// Numbers are formatted straight into the buffer, as they're the most common thing appended.
+	if (is_number(val)) {
+		char buf[MAX_NUMBER_LENGTH];
+		append_bytes_to_string_builder(builder, buf, format_number(buf, as_number(val)));
+		return;
+	}
+
+	value str = value_to_string(val);
+	append_value_to_string_builder(builder, str);
+	free_value(str);
+}
+
+value finish_string_builder(string_builder *builder) {
+	value str;
+
+	if (builder->length <= SMALL_STRING_CAPACITY) {
+		str = new_small_string_value(builder->ptr, builder->length);
+		free(builder->ptr);
+	} else {
+		string *built = new_string(builder->ptr, builder->length);
+		built->capacity = builder->capacity;
+		str = new_string_value(built);
+	}
+
+	builder->ptr = NULL;
+	builder->length = 0;
+	builder->capacity = 0;
+	return str;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <assert.h>
+#include "shared.h"
+#include "valuedefn.h"
+
+/*
+ * A buffer that a string is built up in, which is the value returned by `ringbox`. Its buffer grows
+ * geometrically as it's appended to, and finishing it hands the buffer over to the resulting string
+ * instead of copying it. Unlike strings, builders are mutable, so they're shared by reference like
+ * arrays are.
+ */
+typedef struct {
+	VALUE_ALIGNMENT char *ptr;
+	unsigned refcount, length, capacity;
+} string_builder;
+
+// Initializes a builder that's only used within a single function, such as one on the stack.
+void init_string_builder(string_builder *builder, unsigned capacity);
+
+string_builder *new_string_builder(unsigned capacity);
+void deallocate_string_builder(string_builder *builder);
+
+static inline void free_string_builder(string_builder *builder) {
+	assert(builder->refcount != 0);
+
+	builder->refcount--;
+	if (builder->refcount == 0)
+		deallocate_string_builder(builder);
+}
+
+static inline string_builder *clone_string_builder(string_builder *builder) {
+	assert(builder->refcount != 0);
+
+	builder->refcount++;
+	return builder;
+}
+
+// Makes sure `additional` more bytes can be appended without growing the buffer.
+void reserve_string_builder(string_builder *builder, unsigned additional);
+
+void append_bytes_to_string_builder(string_builder *builder, const char *ptr, unsigned length);
+
+// Appends `val` converted to a string, the same way `value_to_string` converts it.
+void append_value_to_string_builder(string_builder *builder, value val);
+
+// Returns the string that's been built, leaving `builder` empty.
+value finish_string_builder(string_builder *builder);
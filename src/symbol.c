@@ -0,0 +1,120 @@
+#include "symbol.h"
+#include "shared.h"
+#include "index_table.h"
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// Names are never freed, so they're packed into large chunks instead of being allocated one by one.
+#define SYMBOL_NAME_CHUNK_SIZE 65536
+
+static struct {
+	unsigned length, capacity;
+	char **names;
+	unsigned *lengths;
+	index_table by_name;
+	bool is_initialized;
+
+	char *chunk;
+	size_t chunk_remaining;
+} symbols;
+
+static char *allocate_symbol_name(size_t size) {
+	if (size > SYMBOL_NAME_CHUNK_SIZE / 4)
+		return xmalloc(size);
+
+	if (size > symbols.chunk_remaining) {
+		symbols.chunk = xmalloc(SYMBOL_NAME_CHUNK_SIZE);
+		symbols.chunk_remaining = SYMBOL_NAME_CHUNK_SIZE;
+	}
+
+	char *name = symbols.chunk;
+	symbols.chunk += size;
+	symbols.chunk_remaining -= size;
+	return name;
+}
+
+typedef struct {
+	const char *name;
+	size_t length;
+} symbol_query;
+
+static bool symbol_matches(const void *context, unsigned index) {
+	const symbol_query *query = context;
+
+	return symbols.lengths[index] == query->length && !memcmp(symbols.names[index], query->name, query->length);
+}
+
+// Every identifier that's tokenized is hashed, so this hashes eight bytes at a time instead of using
+// the bytewise `hash_bytes`.
+static unsigned long long hash_symbol_name(const char *name, size_t length) {
+	uint64_t hash = length * 0x9e3779b97f4a7c15ULL;
+
+	for (; length >= sizeof(uint64_t); name += sizeof(uint64_t), length -= sizeof(uint64_t)) {
+		uint64_t word;
+		memcpy(&word, name, sizeof(uint64_t));
+		hash = (hash ^ word) * 0xff51afd7ed558ccdULL;
+		hash ^= hash >> 29;
+	}
+
+	if (length != 0) {
+		uint64_t word = 0;
+		memcpy(&word, name, length);
+		hash = (hash ^ word) * 0xff51afd7ed558ccdULL;
+	}
+
+	// Only the low bits pick a slot in the index table, so fold the high bits back down.
+	hash ^= hash >> 32;
+	hash *= 0xc4ceb9fe1a85ec53ULL;
+	return hash ^ (hash >> 29);
+}
+
+static symbol find_symbol_with_hash(const char *name, size_t length, unsigned long long hash) {
+	if (!symbols.is_initialized)
+		return SYMBOL_MISSING;
+
+	symbol_query query = { .name = name, .length = length };
+	return lookup_index_table(&symbols.by_name, hash, symbol_matches, &query);
+}
+
+symbol find_symbol(const char *name, size_t length) {
+	return find_symbol_with_hash(name, length, hash_symbol_name(name, length));
+}
+
+symbol intern_symbol(const char *name, size_t length) {
+	unsigned long long hash = hash_symbol_name(name, length);
+	symbol sym = find_symbol_with_hash(name, length, hash);
+
+	if (sym != SYMBOL_MISSING)
+		return sym;
+
+	if (!symbols.is_initialized) {
+		init_index_table(&symbols.by_name);
+		symbols.is_initialized = true;
+	}
+
+	if (symbols.length == symbols.capacity) {
+		symbols.capacity = symbols.capacity == 0 ? 64 : symbols.capacity * 2;
+		symbols.names = xrealloc(symbols.names, symbols.capacity * sizeof(char *));
+		symbols.lengths = xrealloc(symbols.lengths, symbols.capacity * sizeof(unsigned));
+	}
+
+	char *copy = allocate_symbol_name(length + 1);
+	memcpy(copy, name, length);
+	copy[length] = '\0';
+
+	sym = symbols.length++;
+	symbols.names[sym] = copy;
+	symbols.lengths[sym] = length;
+	insert_index_table(&symbols.by_name, hash, sym);
+
+	return sym;
+}
+
+const char *symbol_name(symbol sym) {
+	return symbols.names[sym];
+}
+
+unsigned number_of_symbols(void) {
+	return symbols.length;
+}
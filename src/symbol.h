@@ -0,0 +1,24 @@
+#pragma once
+
+#include <stddef.h>
+
+/*
+ * Identifiers are interned into symbols when they're tokenized, so that the parser and compiler
+ * can compare and index by a small integer instead of copying, hashing and comparing strings. A
+ * symbol's name lives for the rest of the program.
+ */
+typedef unsigned symbol;
+
+#define SYMBOL_MISSING ((symbol) -1)
+
+// Returns the symbol for the `length` bytes at `name`, interning it if it's new.
+symbol intern_symbol(const char *name, size_t length);
+
+// Returns the symbol for the `length` bytes at `name`, or `SYMBOL_MISSING` if it was never interned.
+symbol find_symbol(const char *name, size_t length);
+
+// Returns the nul-terminated name of `sym`.
+const char *symbol_name(symbol sym);
+
+// Symbols are numbered consecutively from zero, so this can be used to size arrays indexed by them.
+unsigned number_of_symbols(void);
@@ -7,12 +7,18 @@
 #include <stdbool.h>
 #include <assert.h>
 
-tokenizer new_tokenizer(const char *filename, const char *stream) {
+#ifdef __SSE2__
+# include <emmintrin.h>
+#endif
+
+tokenizer new_tokenizer(const char *filename, const char *stream, size_t length) {
 	return (tokenizer) {
 		.stream = stream,
+		.end = stream + length,
 		.filename = filename,
 		.line_number = 1,
-		.prev = (token) { .kind = TOKEN_KIND_UNDEFINED }
+		.prev = (token) { .kind = TOKEN_KIND_UNDEFINED },
+		.ast_arena = NULL
 	};
 }
 
@@ -22,12 +28,21 @@ tokenizer new_tokenizer(const char *filename, const char *stream) {
 	fputc('\n', stderr), \
 	exit(1))
 
+// Returns the next character, or `'\0'` at the end of the stream.
 static char peek(const tokenizer *tzr) {
-	return tzr->stream[0];
+	return tzr->stream == tzr->end ? '\0' : tzr->stream[0];
+}
+
+// Returns the character after the next one, or `'\0'` if there's none.
+static char peek_second(const tokenizer *tzr) {
+	return tzr->end - tzr->stream < 2 ? '\0' : tzr->stream[1];
 }
 
 static void advance(tokenizer *tzr) {
-	if (peek(tzr) == '\n')
+	if (tzr->stream == tzr->end)
+		return;
+
+	if (tzr->stream[0] == '\n')
 		tzr->line_number++;
 
 	tzr->stream++;
@@ -43,6 +58,129 @@ static bool is_alnum_or_underscore(char c) {
 	return isalnum(c) || c == '_';
 }
 
+/*
+ * Scanning functions for the longer tokens. With SSE2 these look at 16 bytes at a time, counting
+ * newlines with popcount, and use `peek`/`advance` for whatever's left over near the end. A nul byte
+ * ends the stream as far as `peek` is concerned, so both ways of scanning must stop at one.
+ */
+#ifdef __SSE2__
+# define CHUNK_SIZE 16
+
+static unsigned equal_mask(__m128i bytes, char c) {
+	return _mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(c)));
+}
+
+// Which bytes are in the range `low` to `high`, inclusive.
+static unsigned range_mask(__m128i bytes, char low, char high) {
+	__m128i offset = _mm_sub_epi8(bytes, _mm_set1_epi8(low));
+	__m128i is_in_range = _mm_cmpeq_epi8(_mm_min_epu8(offset, _mm_set1_epi8(high - low)), offset);
+
+	return _mm_movemask_epi8(is_in_range);
+}
+
+// The same as `isspace` in the "C" locale.
+static unsigned whitespace_mask(__m128i bytes) {
+	return equal_mask(bytes, ' ') | range_mask(bytes, '\t', '\r');
+}
+
+static unsigned identifier_mask(__m128i bytes) {
+	return range_mask(bytes, 'a', 'z')
+		| range_mask(bytes, 'A', 'Z')
+		| range_mask(bytes, '0', '9')
+		| equal_mask(bytes, '_');
+}
+
+// Advances `tzr` to the first byte within the next chunks that's in `stop_mask`, returning false if
+// there's none before the last (partial) chunk.
+static bool advance_chunks_until(tokenizer *tzr, unsigned (*stop_mask)(__m128i bytes, char c), char c) {
+	while (tzr->end - tzr->stream >= CHUNK_SIZE) {
+		__m128i bytes = _mm_loadu_si128((const __m128i *) tzr->stream);
+		unsigned stops = stop_mask(bytes, c);
+		unsigned newlines = equal_mask(bytes, '\n');
+
+		if (stops != 0) {
+			unsigned offset = __builtin_ctz(stops);
+
+			tzr->line_number += __builtin_popcount(newlines & ((1u << offset) - 1));
+			tzr->stream += offset;
+			return true;
+		}
+
+		tzr->line_number += __builtin_popcount(newlines);
+		tzr->stream += CHUNK_SIZE;
+	}
+
+	return false;
+}
+
+static unsigned non_whitespace_mask(__m128i bytes, char unused) {
+	(void) unused;
+	return ~whitespace_mask(bytes) & 0xffff;
+}
+
+static unsigned non_identifier_mask(__m128i bytes, char unused) {
+	(void) unused;
+	return ~identifier_mask(bytes) & 0xffff;
+}
+
+static unsigned line_end_mask(__m128i bytes, char unused) {
+	(void) unused;
+	return equal_mask(bytes, '\n') | equal_mask(bytes, '\0');
+}
+
+static unsigned string_special_mask(__m128i bytes, char quote) {
+	return equal_mask(bytes, quote) | equal_mask(bytes, '\\') | equal_mask(bytes, '\0');
+}
+#endif
+
+static void skip_whitespace(tokenizer *tzr) {
+#ifdef __SSE2__
+	if (advance_chunks_until(tzr, non_whitespace_mask, 0))
+		return;
+#endif
+
+	while (isspace(peek(tzr)))
+		advance(tzr);
+}
+
+// Skips to the start of the next line.
+static void skip_line(tokenizer *tzr) {
+#ifdef __SSE2__
+	// This leaves `tzr` at the end of the line, which the loop below then skips past.
+	advance_chunks_until(tzr, line_end_mask, 0);
+#endif
+
+	char c;
+	while ((c = peek(tzr)) != '\0') {
+		advance(tzr);
+
+		if (c == '\n')
+			break;
+	}
+}
+
+static void skip_identifier(tokenizer *tzr) {
+#ifdef __SSE2__
+	if (advance_chunks_until(tzr, non_identifier_mask, 0))
+		return;
+#endif
+
+	while (is_alnum_or_underscore(peek(tzr)))
+		advance(tzr);
+}
+
+// Skips to the next `quote` or backslash within a string, or the end of the stream.
+static void skip_string_contents(tokenizer *tzr, char quote) {
+#ifdef __SSE2__
+	if (advance_chunks_until(tzr, string_special_mask, quote))
+		return;
+#endif
+
+	char c;
+	while ((c = peek(tzr)) != '\0' && c != quote && c != '\\')
+		advance(tzr);
+}
+
 static token parse_number(tokenizer *tzr) {
 	number num = 0;
 	char c;
@@ -65,33 +203,62 @@ static token parse_identifier(tokenizer *tzr) {
 	const char *start = tzr->stream;
 
 	// find the length of the identifier.
-	while (is_alnum_or_underscore(peek(tzr)))
-		advance(tzr);
+	skip_identifier(tzr);
 
 	unsigned length = tzr->stream - start;
 
-	// check for predefined identifiers
-	if (!strncmp(start, "good", 4)) return (token) { .kind = TOKEN_KIND_LITERAL, .val = VALUE_TRUE };
-	if (!strncmp(start, "evil", 4)) return (token) { .kind = TOKEN_KIND_LITERAL, .val = VALUE_FALSE };
-	if (!strncmp(start, "chaos_emerald", 13)) return (token) { .kind = TOKEN_KIND_LITERAL, .val = VALUE_NULL };
-	if (!strncmp(start, "friend", 6)) return (token) { .kind = TOKEN_KIND_IMPORT };
-	if (!strncmp(start, "dr_eggman", 9)) return (token) { .kind = TOKEN_KIND_GLOBAL };
-	if (!strncmp(start, "mission", 7)) return (token) { .kind = TOKEN_KIND_FUNCTION };
-	if (!strncmp(start, "hedgehog", 8)) return (token) { .kind = TOKEN_KIND_LOCAL };
-	if (!strncmp(start, "hmmm", 4)) return (token) { .kind = TOKEN_KIND_IF };
-	if (!strncmp(start, "ormaybe", 7)) return (token) { .kind = TOKEN_KIND_ELSE };
-	if (!strncmp(start, "loopdeloop", 9)) return (token) { .kind = TOKEN_KIND_WHILE };
-	if (!strncmp(start, "eachring", 8)) return (token) { .kind = TOKEN_KIND_FOR };
-	if (!strncmp(start, "jump", 4)) return (token) { .kind = TOKEN_KIND_BREAK };
-	if (!strncmp(start, "carryon", 7)) return (token) { .kind = TOKEN_KIND_CONTINUE };
-	if (!strncmp(start, "nopeseeya", 9)) return (token) { .kind = TOKEN_KIND_RETURN };
-	if (!strncmp(start, "start", 5)) return (token) { .kind = TOKEN_KIND_LBRACE };
-	if (!strncmp(start, "finish", 5)) return (token) { .kind = TOKEN_KIND_RBRACE };
+	// check for predefined identifiers; only those with the same length need to be compared.
+#define KEYWORD(name, ...) \
+	if (!memcmp(start, name, length)) return (token) { __VA_ARGS__ }
+
+	switch (length) {
+	case 4:
+		KEYWORD("good", .kind = TOKEN_KIND_LITERAL, .val = VALUE_TRUE);
+		KEYWORD("evil", .kind = TOKEN_KIND_LITERAL, .val = VALUE_FALSE);
+		KEYWORD("hmmm", .kind = TOKEN_KIND_IF);
+		KEYWORD("jump", .kind = TOKEN_KIND_BREAK);
+		break;
+
+	case 5:
+		KEYWORD("start", .kind = TOKEN_KIND_LBRACE);
+		break;
+
+	case 6:
+		KEYWORD("friend", .kind = TOKEN_KIND_IMPORT);
+		KEYWORD("finish", .kind = TOKEN_KIND_RBRACE);
+		break;
+
+	case 7:
+		KEYWORD("mission", .kind = TOKEN_KIND_FUNCTION);
+		KEYWORD("ormaybe", .kind = TOKEN_KIND_ELSE);
+		KEYWORD("carryon", .kind = TOKEN_KIND_CONTINUE);
+		break;
+
+	case 8:
+		KEYWORD("hedgehog", .kind = TOKEN_KIND_LOCAL);
+		KEYWORD("eachring", .kind = TOKEN_KIND_FOR);
+		break;
+
+	case 9:
+		KEYWORD("dr_eggman", .kind = TOKEN_KIND_GLOBAL);
+		KEYWORD("nopeseeya", .kind = TOKEN_KIND_RETURN);
+		break;
+
+	case 10:
+		KEYWORD("loopdeloop", .kind = TOKEN_KIND_WHILE);
+		break;
+
+	case 13:
+		KEYWORD("chaos_emerald", .kind = TOKEN_KIND_LITERAL, .val = VALUE_NULL);
+		break;
+	}
+
+#undef KEYWORD
 
 	// it's a normal identifier, return that.
 	return (token) {
 		.kind = TOKEN_KIND_IDENTIFIER,
-		.identifier = strndup(start, length)
+		.identifier = intern_symbol(start, length)
 	};
 }
 
@@ -123,7 +290,7 @@ static char get_escape_char(tokenizer *tzr) {
 	case '0': return '\0';
 
 	case 'x':
-		if (tzr->stream[0] == '\0' || tzr->stream[1] == '\0')
+		if (peek(tzr) == '\0' || peek_second(tzr) == '\0')
 			parse_error(tzr, "unterminated '\\x' sequence encountered");
 
 		char upper_nibble = peek_advance(tzr);
@@ -140,31 +307,58 @@ static token parse_string(tokenizer *tzr) {
 	char quote = peek_advance(tzr);
 	assert(quote == '\'' || quote == '\"');
 
+	unsigned starting_line = tzr->line_number;
+	const char *start = tzr->stream;
+	skip_string_contents(tzr, quote);
+	unsigned run_length = tzr->stream - start;
+
+	// Most strings have no escapes, in which case they're copied straight out of the source.
+	if (peek(tzr) == quote) {
+		advance(tzr);
+
+		return (token) {
+			.kind = TOKEN_KIND_LITERAL,
+			.val = intern_string_value(start, run_length)
+		};
+	}
+
 	unsigned length = 0;
 	unsigned capacity = 8;
-	char *str = xmalloc(capacity); // no need for `+1` because strings dont have trailing `\0`.
+	char *str = xmalloc(capacity);
 
-	unsigned starting_line = tzr->line_number;
+	while (true) {
+		// Leave room for the escape character, if there is one.
+		if (capacity < length + run_length + 1) {
+			while (capacity < length + run_length + 1)
+				capacity *= 2;
+			str = xrealloc(str, capacity);
+		}
+
+		memcpy(&str[length], start, run_length);
+		length += run_length;
+
+		char c = peek_advance(tzr);
 
-	char c;
-	while ((c = peek_advance(tzr)) != quote) {
 		if (c == '\0')
 			parse_error(tzr, "unterminated quote encountered starting on line %d", starting_line);
 
-		if (c == '\\')
-			c = get_escape_char(tzr);
+		if (c == quote)
+			break;
 
-		if (length == capacity) {
-			capacity *= 2;
-			str = xrealloc(str, capacity);
-		}
+		str[length++] = get_escape_char(tzr);
 
-		str[length++] = c;
+		// Copy everything up to the next quote or escape at once.
+		start = tzr->stream;
+		skip_string_contents(tzr, quote);
+		run_length = tzr->stream - start;
 	}
 
+	value interned = intern_string_value(str, length);
+	free(str);
+
 	return (token) {
 		.kind = TOKEN_KIND_LITERAL,
-		.val = new_string_value(new_string(str, length))
+		.val = interned
 	};
 }
 
@@ -177,14 +371,13 @@ static void strip_leading_whitespace_and_comments(tokenizer *tzr) {
 			return;
 
 		if (isspace(c)) {
-			advance(tzr);
+			skip_whitespace(tzr);
 			continue;
 		}
 
 		// only c-style line comments are recognized
-		if (c == '/' && tzr->stream[1] == '/') {
-			while (c != '\0' && c != '\n')
-				c = peek_advance(tzr);
+		if (c == '/' && peek_second(tzr) == '/') {
+			skip_line(tzr);
 			continue;
 		}
 
@@ -259,7 +452,7 @@ void dump_token(FILE *out, token tkn) {
 	case TOKEN_KIND_UNDEFINED: fputs("UNDEF", out); break;
 
 	case TOKEN_KIND_LITERAL: dump_value(out, tkn.val); break;
-	case TOKEN_KIND_IDENTIFIER: fprintf(out, "Identifier(%s)\n", tkn.identifier); break;
+	case TOKEN_KIND_IDENTIFIER: fprintf(out, "Identifier(%s)\n", symbol_name(tkn.identifier)); break;
 
 	case TOKEN_KIND_IMPORT: fputs("Keyword(friend)", out); break;
 	case TOKEN_KIND_GLOBAL: fputs("Keyword(dr_eggman)", out); break;
@@ -1,6 +1,8 @@
 #pragma once
 #include <stdio.h>
 #include "valuedefn.h"
+#include "symbol.h"
+#include "arena.h"
 
 typedef enum {
 	// Indicates that the token isn't actually a token.
@@ -46,16 +48,20 @@ typedef struct {
 	token_kind kind;
 	union {
 		value val;
-		char *identifier;
+		symbol identifier;
 	};
 } token;
 
 typedef struct {
-	const char *stream, *filename;
+	// `end` points just past the last character; the stream needn't be nul terminated.
+	const char *stream, *end, *filename;
 	unsigned line_number;
 	token prev;
+
+	// Where the parser allocates the AST of the declaration it's currently parsing.
+	arena *ast_arena;
 } tokenizer;
 
-tokenizer new_tokenizer(const char *filename, const char *stream);
+tokenizer new_tokenizer(const char *filename, const char *stream, size_t length);
 token next_token(tokenizer *tzr);
 void dump_token(FILE *out, token tkn);
@@ -25,8 +25,15 @@ void dump_value(FILE *out, value val) {
 		fputs("Null()", out);
 		break;
 
-	case VALUE_KIND_STRING:
-		fprintf(out, "String(%.*s)", as_string(val)->length, as_string(val)->ptr);
+	case VALUE_KIND_STRING: {
+		string_contents contents;
+		get_string_contents(val, &contents);
+		fprintf(out, "String(%.*s)", contents.length, contents.ptr);
+		break;
+	}
+
+	case VALUE_KIND_STRING_BUILDER:
+		fprintf(out, "StringBuilder(%.*s)", as_string_builder(val)->length, as_string_builder(val)->ptr);
 		break;
 
 	case VALUE_KIND_NUMBER:
@@ -38,7 +45,8 @@ void dump_value(FILE *out, value val) {
 void free_value(value val) {
 	switch (classify(val)) {
 	case VALUE_KIND_STRING:
-		free_string(as_string(val));
+		if (!is_small_string(val))
+			free_string(as_string(val));
 		break;
 
 	case VALUE_KIND_ARRAY:
@@ -49,6 +57,10 @@ void free_value(value val) {
 		free_function(as_function(val));
 		break;
 
+	case VALUE_KIND_STRING_BUILDER:
+		free_string_builder(as_string_builder(val));
+		break;
+
 	default:
 		// We don't free builtin functions, as they're static for the lifetime of the program.
 		break;
@@ -58,7 +70,7 @@ void free_value(value val) {
 value clone_value(value val) {
 	switch (classify(val)) {
 	case VALUE_KIND_STRING:
-		return new_string_value(clone_string(as_string(val)));
+		return is_small_string(val) ? val : new_string_value(clone_string(as_string(val)));
 
 	case VALUE_KIND_ARRAY:
 		return new_array_value(clone_array(as_array(val)));
@@ -66,6 +78,9 @@ value clone_value(value val) {
 	case VALUE_KIND_FUNCTION:
 		return new_function_value(clone_function(as_function(val)));
 
+	case VALUE_KIND_STRING_BUILDER:
+		return new_string_builder_value(clone_string_builder(as_string_builder(val)));
+
 	default:
 		return val;
 	}
@@ -80,6 +95,7 @@ const char *value_kind_name(value_kind kind) {
 	case VALUE_KIND_NUMBER:           return "number";
 	case VALUE_KIND_FUNCTION:         return "function";
 	case VALUE_KIND_BUILTIN_FUNCTION: return "function"; // Should be indistinguishable from user-defined
+	case VALUE_KIND_STRING_BUILDER:   return "ringbox";
 	}
 }
 
@@ -115,12 +131,12 @@ value index_value(value val, value idx) {
 
 	switch (classify(val)) {
 	case VALUE_KIND_STRING: {
-		string *str = index_string(as_string(val), num_idx);
+		value chr = index_string(val, num_idx);
 
-		if (str == NULL)
-			die_with_stacktrace("index %lld out of bounds for string of length %u", num_idx, as_string(val)->length);
+		if (chr == VALUE_UNDEFINED)
+			die_with_stacktrace("index %lld out of bounds for string of length %u", num_idx, string_length(val));
 
-		return new_string_value(str);
+		return chr;
 	}
 
 	case VALUE_KIND_ARRAY: {
@@ -151,28 +167,31 @@ value not_value(value val) {
 	return new_boolean_value(!as_boolean(val));
 }
 
-string *value_to_string(value val) {
+value value_to_string(value val) {
 	switch (classify(val)) {
 	case VALUE_KIND_STRING:
-		return clone_string(as_string(val));
+		return clone_value(val);
 
 	case VALUE_KIND_NUMBER:
 		return number_to_string(as_number(val));
 
-	// `new_string` requires ownership of its string, so we `strdup`.
 	case VALUE_KIND_BOOLEAN:
 		if (val == VALUE_TRUE) {
-			return new_string(strdup("good"), 4);
+			return intern_string_value("good", 4);
 		} else {
-			return new_string(strdup("evil"), 4);
+			return intern_string_value("evil", 4);
 		}
 
 	case VALUE_KIND_NULL:
-		return new_string(strdup("chaos_emerald"), 13);
+		return intern_string_value("chaos_emerald", 13);
 
 	case VALUE_KIND_ARRAY:
 		return array_to_string(as_array(val));
 
+	// It's converted to what's been built so far, which is left in the builder.
+	case VALUE_KIND_STRING_BUILDER:
+		return new_string_value_from_bytes(as_string_builder(val)->ptr, as_string_builder(val)->length);
+
 	default:
 		die_with_stacktrace("no conversion to string defined for %s", value_name(val));
 	}
@@ -197,15 +216,15 @@ value add_values(value lhs, value rhs) {
 
 	case VALUE_KIND_STRING:
 	string: {
-		string *l = value_to_string(lhs);
-		string *r = value_to_string(rhs);
+		value l = value_to_string(lhs);
+		value r = value_to_string(rhs);
 
-		string *ret = add_strings(l, r);
+		value ret = add_strings(l, r);
 
-		free_string(l);
-		free_string(r);
+		free_value(l);
+		free_value(r);
 
-		return new_string_value(ret);
+		return ret;
 	}
 
 	default:
@@ -213,6 +232,24 @@ value add_values(value lhs, value rhs) {
 	}
 }
 
+value append_values(value lhs, value rhs) {
+	if (is_string(lhs) && !is_small_string(lhs) && is_string_uniquely_owned(as_string(lhs))) {
+		value r = value_to_string(rhs);
+		append_string(as_string(lhs), r);
+		free_value(r);
+		return lhs;
+	}
+
+	if (is_array(lhs) && is_array(rhs) && as_array(lhs)->refcount == 1) {
+		append_array(as_array(lhs), as_array(rhs));
+		return lhs;
+	}
+
+	value ret = add_values(lhs, rhs);
+	free_value(lhs);
+	return ret;
+}
+
 value subtract_values(value lhs, value rhs) {
 	// Yes its backwards intentionally; English is weird.
 	if (!is_number(lhs) || !is_number(rhs)) {
@@ -237,7 +274,7 @@ value multiply_values(value lhs, value rhs) {
 		if (amnt < 0)
 			die_with_stacktrace("can only multiply strings by nonnegative integers (%lld invalid).", amnt);
 
-		return new_string_value(replicate_string(as_string(lhs), amnt));
+		return replicate_string(lhs, amnt);
 
 	case VALUE_KIND_ARRAY:
 		if (amnt < 0)
@@ -282,7 +319,7 @@ int compare_values(value lhs, value rhs) {
 		return compare_arrays(as_array(lhs), as_array(rhs));
 
 	case VALUE_KIND_STRING:
-		return compare_strings(as_string(lhs), as_string(rhs));
+		return compare_strings(lhs, rhs);
 
 	default:
 		die_with_stacktrace("can only compare numbers, arrays, and strings, not %s", value_name(lhs));
@@ -304,16 +341,62 @@ bool equate_values(value lhs, value rhs) {
 	case VALUE_KIND_NUMBER:
 	case VALUE_KIND_FUNCTION:
 	case VALUE_KIND_BUILTIN_FUNCTION:
+	case VALUE_KIND_STRING_BUILDER:
 		return false; // If `lhs` isn't identical to `rhs`, then they're not equivalent.
 
 	case VALUE_KIND_STRING:
-		return equate_strings(as_string(lhs), as_string(rhs));
+		return equate_strings(lhs, rhs);
 
 	case VALUE_KIND_ARRAY:
 		return equate_arrays(as_array(lhs), as_array(rhs));
 	}
 }
 
-string *inspect_value(value val) {
-	return is_string(val) ? inspect_string(as_string(val)) : value_to_string(val);
+value inspect_value(value val) {
+	return is_string(val) ? inspect_string(val) : value_to_string(val);
+}
+
+void print_value(FILE *out, value val) {
+	switch (classify(val)) {
+	case VALUE_KIND_STRING: {
+		string_contents contents;
+		get_string_contents(val, &contents);
+		fwrite(contents.ptr, 1, contents.length, out);
+		return;
+	}
+
+	case VALUE_KIND_NUMBER: {
+		char buf[MAX_NUMBER_LENGTH];
+		fwrite(buf, 1, format_number(buf, as_number(val)), out);
+		return;
+	}
+
+	case VALUE_KIND_BOOLEAN:
+		fputs(val == VALUE_TRUE ? "good" : "evil", out);
+		return;
+
+	case VALUE_KIND_NULL:
+		fputs("chaos_emerald", out);
+		return;
+
+	case VALUE_KIND_ARRAY:
+		print_array(out, as_array(val));
+		return;
+
+	// A finished builder has no buffer at all, which can't be passed to `fwrite`.
+	case VALUE_KIND_STRING_BUILDER:
+		if (as_string_builder(val)->length != 0)
+			fwrite(as_string_builder(val)->ptr, 1, as_string_builder(val)->length, out);
+		return;
+
+	default:
+		die_with_stacktrace("no conversion to string defined for %s", value_name(val));
+	}
+}
+
+void print_inspected_value(FILE *out, value val) {
+	if (is_string(val))
+		print_inspected_string(out, val);
+	else
+		print_value(out, val);
 }
@@ -7,6 +7,7 @@
 #include "valuedefn.h"
 #include "shared.h"
 #include "string.h"
+#include "string_builder.h"
 #include "array.h"
 #include "number.h"
 #include "function.h"
@@ -38,6 +39,14 @@ XXX...001 = user-defined function
 XXX...010 = ary
 XXX...011 = builtin function
 XXX...100 = number
+XXX...101 = small string
+XXX...110 = string builder
+
+Strings of up to `SMALL_STRING_CAPACITY` bytes are always small strings, which are stored in the
+value itself instead of being allocated: their bytes are in the upper seven bytes (the first byte
+in bits 8-15, and so on), and their length is in bits 3-5. Like strings, they're `VALUE_KIND_STRING`,
+and the functions in `string.h` take either kind. As a string's kind only depends on its length,
+small strings are only ever equal to small strings.
 */
 enum {
 	VALUE_TAG_STRING           = 0,
@@ -45,9 +54,13 @@ enum {
 	VALUE_TAG_ARRAY            = 2,
 	VALUE_TAG_BUILTIN_FUNCTION = 3,
 	VALUE_TAG_NUMBER           = 4,
+	VALUE_TAG_SMALL_STRING     = 5,
+	VALUE_TAG_STRING_BUILDER   = 6,
 	VALUE_TAG_MASK             = 7,
 };
 
+#define SMALL_STRING_CAPACITY 7
+
 /*
  * An enum used to indicate what type a `value` is.
  *
@@ -60,6 +73,7 @@ typedef enum {
 	VALUE_KIND_BUILTIN_FUNCTION = VALUE_TAG_BUILTIN_FUNCTION,
 	VALUE_KIND_ARRAY            = VALUE_TAG_ARRAY,
 	VALUE_KIND_NUMBER           = VALUE_TAG_NUMBER,
+	VALUE_KIND_STRING_BUILDER   = VALUE_TAG_STRING_BUILDER,
 	VALUE_KIND_BOOLEAN          = VALUE_TAG_MASK + 1, // guaranteed to not be a tag
 	VALUE_KIND_NULL             = VALUE_TAG_MASK + 2, // also guaranteed not to eb a tag.
 } value_kind;
@@ -77,6 +91,9 @@ static inline value_kind classify(value val) {
 	if (val == VALUE_TRUE || val == VALUE_FALSE)
 		return VALUE_KIND_BOOLEAN;
 
+	if ((val & VALUE_TAG_MASK) == VALUE_TAG_SMALL_STRING)
+		return VALUE_KIND_STRING;
+
 	return val & VALUE_TAG_MASK;
 }
 
@@ -101,12 +118,24 @@ static inline value new_number_value(number num) {
 	return ((value) num << 3) | VALUE_TAG_NUMBER;
 }
 
-// Creates a new `value` out of a `string`.
+// Creates a new `value` out of a `string`, which must be too long to be a small string.
 static inline value new_string_value(string *str) {
 	assert(((value) str & VALUE_TAG_MASK) == 0); // Sanity check for alignment.
+	assert(str->length > SMALL_STRING_CAPACITY);
 	return (value) str | VALUE_TAG_STRING;
 }
 
+// Creates a small string out of the `length` bytes starting at `ptr`.
+static inline value new_small_string_value(const char *ptr, unsigned length) {
+	assert(length <= SMALL_STRING_CAPACITY);
+
+	value val = (value) length << 3 | VALUE_TAG_SMALL_STRING;
+	for (unsigned i = 0; i < length; i++)
+		val |= (value) (unsigned char) ptr[i] << (8 * (i + 1));
+
+	return val;
+}
+
 // Creates a new `value` out of a `function`.
 static inline value new_function_value(function *func) {
 	assert(((value) func & VALUE_TAG_MASK) == 0); // Sanity check for alignment.
@@ -119,6 +148,12 @@ static inline value new_builtin_function_value(builtin_function *builtin_func) {
 	return (value) builtin_func | VALUE_TAG_BUILTIN_FUNCTION;
 }
 
+// Creates a new `value` out of a `string_builder`.
+static inline value new_string_builder_value(string_builder *builder) {
+	assert(((value) builder & VALUE_TAG_MASK) == 0); // Sanity check for alignment.
+	return (value) builder | VALUE_TAG_STRING_BUILDER;
+}
+
 // Note that there's no `is_null` as you can just do `== NULL`
 
 // Checks if `val` is a `bool`.
@@ -141,6 +176,16 @@ static inline bool is_string(value val) {
 	return classify(val) == VALUE_KIND_STRING;
 }
 
+// Checks if `val` is a string that's stored within the value.
+static inline bool is_small_string(value val) {
+	return (val & VALUE_TAG_MASK) == VALUE_TAG_SMALL_STRING;
+}
+
+// Checks if `val` is a `string_builder`.
+static inline bool is_string_builder(value val) {
+	return classify(val) == VALUE_KIND_STRING_BUILDER;
+}
+
 // Checks if `val` is a `function`.
 static inline bool is_function(value val) {
 	return classify(val) == VALUE_KIND_FUNCTION;
@@ -169,18 +214,51 @@ static inline array *as_array(value val) {
 	return (array *) (val & ~VALUE_TAG_MASK);
 }
 
-// Casts `val` to a `string` without verifying its type.
+// Casts `val` to a `string` without verifying its type. Small strings aren't `string`s; use
+// `get_string_contents` to read strings of either kind.
 static inline string *as_string(value val) {
-	assert(is_string(val));
+	assert(is_string(val) && !is_small_string(val));
 	return (string *) (val & ~VALUE_TAG_MASK);
 }
 
+// The bytes of a string of either kind. A small string's bytes are unpacked into `small`, so `ptr`
+// is only valid for as long as the `string_contents` is.
+typedef struct {
+	const char *ptr;
+	unsigned length;
+	char small[SMALL_STRING_CAPACITY];
+} string_contents;
+
+static inline unsigned string_length(value val) {
+	return is_small_string(val) ? (val >> 3) & 7 : as_string(val)->length;
+}
+
+static inline void get_string_contents(value val, string_contents *contents) {
+	contents->length = string_length(val);
+
+	if (!is_small_string(val)) {
+		contents->ptr = as_string(val)->ptr;
+		return;
+	}
+
+	for (unsigned i = 0; i < contents->length; i++)
+		contents->small[i] = val >> (8 * (i + 1));
+
+	contents->ptr = contents->small;
+}
+
 // Casts `val` to a `function` without verifying its type.
 static inline function *as_function(value val) {
 	assert(is_function(val));
 	return (function *) (val & ~VALUE_TAG_MASK);
 }
 
+// Casts `val` to a `string_builder` without verifying its type.
+static inline string_builder *as_string_builder(value val) {
+	assert(is_string_builder(val));
+	return (string_builder *) (val & ~VALUE_TAG_MASK);
+}
+
 // Casts `val` to a `builtin_function` without verifying its type.
 static inline builtin_function *as_builtin_function(value val) {
 	assert(is_builtin_function(val));
@@ -199,10 +277,15 @@ void free_value(value val);
 value clone_value(value val);
 
 // Converts `val` to a string.
-string *value_to_string(value val);
+value value_to_string(value val);
+
+// Gets a debugging representation of `val`, as a string.
+value inspect_value(value val);
 
-// Gets a debugging representation of `val`.
-string *inspect_value(value val);
+// These write what `value_to_string` and `inspect_value` would return to `out`. Nothing's allocated,
+// so printing a huge array doesn't need a copy of its text.
+void print_value(FILE *out, value val);
+void print_inspected_value(FILE *out, value val);
 
 // Calls `val` with the given arguments.
 value call_value(value val, unsigned number_of_arguments, const value *arguments);
@@ -216,6 +299,10 @@ value not_value(value val);
 // Adds `lhs` to `rhs`.
 value add_values(value lhs, value rhs);
 
+// Adds `rhs` onto `lhs`, taking ownership of `lhs`. Strings and arrays that nothing else refers to
+// are appended to in place, instead of being copied into a new one.
+value append_values(value lhs, value rhs);
+
 // Subtracts `rhs` from `lhs`.
 value subtract_values(value lhs, value rhs);
 
@@ -0,0 +1,26 @@
+#!/bin/sh
+# A nul byte ends the source code, wherever it falls within the tokenizer's 16-byte chunks.
+# usage: tests/nul_bytes.sh [path to emerald]
+
+emerald=${1:-./emerald}
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+status=0
+
+for offset in $(seq 0 40); do
+	padding=$(printf "%${offset}s" "" | tr ' ' a)
+
+	printf 'mission main() gottagofast("%s\0b") finish\n' "$padding" > "$dir/string.em"
+	if ! "$emerald" -f "$dir/string.em" 2>&1 | grep -q "unterminated quote"; then
+		echo "a nul byte $offset bytes into a string didn't end it"
+		status=1
+	fi
+
+	printf '// %s\0\nmission main() gottagofast(1) finish\n' "$padding" > "$dir/comment.em"
+	if ! "$emerald" -f "$dir/comment.em" 2>&1 | grep -q "must define a \`main\` function"; then
+		echo "a nul byte $offset bytes into a comment didn't end the source"
+		status=1
+	fi
+done
+
+exit $status
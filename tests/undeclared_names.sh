@@ -0,0 +1,63 @@
+#!/bin/sh
+# Names are resolved when a function's declared, even though its body's only compiled when it's
+# first called, so these programs are rejected whether the function's called or not, and however
+# the program's compiled: run, run across threads, written to an image, or loaded from the cache.
+# usage: tests/undeclared_names.sh [path to emerald]
+
+emerald=${1:-./emerald}
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+mkdir "$dir/cache"
+status=0
+
+# Checks that compiling `$1` (in every way) fails with a message containing `$2`.
+expect_error() {
+	for mode in run threads image cache; do
+		case $mode in
+		run) output=$("$emerald" -f "$1" 2>&1) ;;
+		threads) output=$(EMERALD_COMPILE_THREADS=2 "$emerald" -f "$1" 2>&1) ;;
+		image) output=$("$emerald" -o "$dir/image" "$1" 2>&1) ;;
+		cache) output=$(EMERALD_CACHE_DIR="$dir/cache" "$emerald" -f "$1" 2>&1) ;;
+		esac
+
+		case $output in
+		*"$2"*) ;;
+		*)
+			echo "$1 ($mode) didn't fail with \"$2\":"
+			echo "$output"
+			status=1
+			;;
+		esac
+	done
+}
+
+printf 'mission main() later() finish\nmission later() finish\n' > "$dir/forward_function.em"
+expect_error "$dir/forward_function.em" "undeclared variable 'later'"
+
+printf 'mission main() gottagofast(later) finish\ndr_eggman later\n' > "$dir/forward_global.em"
+expect_error "$dir/forward_global.em" "undeclared variable 'later'"
+
+printf 'mission main() later = 1 finish\ndr_eggman later\n' > "$dir/forward_assignment.em"
+expect_error "$dir/forward_assignment.em" "unknown variable 'later'"
+
+printf 'mission unused() nopeseeya missing finish\nmission main() finish\n' > "$dir/uncalled.em"
+expect_error "$dir/uncalled.em" "undeclared variable 'missing'"
+
+printf 'mission unused() jump finish\nmission main() finish\n' > "$dir/break.em"
+expect_error "$dir/break.em" "cannot break when not within a while"
+
+# A cached file's globals are checked against what's declared when it's loaded, not when it was
+# cached, so `lib.em` only compiles when `helper` is declared before importing it.
+printf 'mission lib() nopeseeya helper() finish\n' > "$dir/lib.em"
+printf 'mission helper() nopeseeya "helped" finish\nfriend "%s"\nmission main() gottagofast(lib()) finish\n' \
+	"$dir/lib.em" > "$dir/declares_first.em"
+printf 'friend "%s"\nmission helper() nopeseeya "helped" finish\nmission main() gottagofast(lib()) finish\n' \
+	"$dir/lib.em" > "$dir/declares_later.em"
+
+if ! EMERALD_CACHE_DIR="$dir/cache" "$emerald" -f "$dir/declares_first.em" 2>&1 | grep -q helped; then
+	echo "$dir/declares_first.em didn't run"
+	status=1
+fi
+expect_error "$dir/declares_later.em" "undeclared variable 'helper'"
+
+exit $status